@@ -0,0 +1,67 @@
+#!/bin/sh
+# Compile a program whose variables are named after every C keyword of C89
+# to C23 and GNU C, and after every library and runtime name the C target
+# writes, with --target=c. The C must build with cc in the default, C11 and
+# C23 modes and print what the RAMM build prints.
+# usage: bench/cnames.sh
+set -e
+
+work=${TMPDIR:-/tmp}/pascallite-cnames.$$
+mkdir -p "$work"
+trap 'rm -rf "$work"' EXIT
+
+g++ -O2 -o "$work/stage02" stage02.cpp
+g++ -O2 -o "$work/ramm" ramm.cpp
+
+# Names that are also Pascallite keywords cannot be declared and are left out
+names="auto break case char const continue default do double else enum extern
+float for goto if inline int long register restrict return short signed sizeof
+static struct switch typedef union unsigned void volatile while bool true false
+nullptr constexpr alignas alignof static_assert thread_local typeof
+typeof_unqual asm main errno stdin stdout stderr setvbuf printf scanf fputs
+exit value dividend divisor"
+keywords=" program const var integer boolean begin end true false not mod div
+and or read write if then else while do repeat until "
+
+echo "$names" | tr ' ' '\n' | awk -v keywords="$keywords" '
+BEGIN {
+	split(keywords, list, /[ \n]+/)
+	for (i in list)
+		reserved[list[i]] = 1
+	count = 0
+}
+NF > 0 && !($1 in reserved) {
+	declared[count] = $1
+	count += 1
+}
+END {
+	print "program cnames;"
+	print "var total : integer;"
+	for (i = 0; i < count; i += 1)
+		print "  " declared[i] " : integer;"
+	print "begin"
+	print "  read(total);"
+	for (i = 0; i < count; i += 1)
+	{
+		print "  " declared[i] " := total + " i ";"
+		print "  total := total + " declared[i] ";"
+	}
+	print "  write(total, main, setvbuf);"
+	print "end."
+}' > "$work/cnames.pas"
+
+"$work/stage02" "$work/cnames.pas" "$work/ramm.lst" "$work/cnames.obj"
+"$work/stage02" --target=c "$work/cnames.pas" "$work/c.lst" "$work/cnames.c"
+expected=$("$work/ramm" --input=1 "$work/cnames.obj")
+
+for standard in "" -std=c11 -std=c2x -std=gnu2x
+do
+	cc -O2 $standard -o "$work/cnames" "$work/cnames.c"
+	output=$(echo 1 | "$work/cnames")
+	if [ "$output" != "$expected" ]
+	then
+		echo "cc $standard: printed $output, expected $expected"
+		exit 1
+	fi
+	echo "cc ${standard:-(default)}: same output as the RAMM"
+done
@@ -0,0 +1,668 @@
+// Brian Leary
+//Joseph Lynch
+/*
+	This program measures how fast the Pascallite compiler compiles. It
+	generates valid Pascallite programs from a seed, compiles them at sizes
+	from a kilobyte to a hundred megabytes, and reports lines and tokens per
+	second and the peak memory of every compile in JSON or tab separated form,
+	and how much faster --check only lexes, parses and type checks it.
+	With --generate it only writes one program.
+*/
+
+#include <iostream>
+#include <sstream>
+#include <fstream>
+#include <iomanip>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <random>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#include <fcntl.h>
+
+using namespace std;
+
+// Knobs of the generated programs
+struct knobs
+{
+	unsigned long long seed;
+	unsigned int constants;
+	unsigned int variables;
+	unsigned int depth;
+	unsigned long long statements;
+	unsigned int nesting;
+	double literals;
+	double errors;
+	unsigned long long size;
+};
+
+// Define the measurements of one compile
+struct measurement
+{
+	unsigned long long size;
+	unsigned long long bytes;
+	unsigned long long lines;
+	unsigned long long tokens;
+	double seconds;
+	double parseSeconds;
+	double checkSeconds;
+	long peakKilobytes;
+	int status;
+};
+
+// Generator state: the random numbers, the line being written and the
+// counts of what was written
+mt19937_64 generator;
+knobs settings;
+ofstream programFile;
+string currentLine = "";
+unsigned long long lineCount = 0;
+unsigned long long tokenCount = 0;
+unsigned long long byteCount = 0;
+
+// Function prototypes
+unsigned int Random(unsigned int n);
+bool Chance(double p);
+void Put(string token);
+void NewLine(unsigned int indent);
+string IntegerLeaf();
+string BooleanLeaf(bool alone);
+void IntegerExpression(unsigned int depth);
+void BooleanExpression(unsigned int depth);
+void Statement(unsigned int indent, unsigned int nesting, bool allowIf);
+void GenerateProgram(string fileName);
+measurement Compile(string compiler, string fileName, string work, unsigned long long size);
+double Check(string compiler, string fileName, string work);
+unsigned long long ParseSize(string text);
+void WriteMeasurement(measurement result, string format, bool first);
+
+int main(int argc, char **argv)
+{
+	// Usage: compilebench [--seed=n] [--constants=n] [--variables=n] [--depth=n]
+	//                     [--statements=n] [--nesting=n] [--literals=p] [--errors=p]
+	//                     (--generate=file [--size=bytes] | [--sizes=list]
+	//                     [--compiler=path] [--runs=n] [--format=json|tsv])
+	string option, generateName = "", compiler = "./stage02", format = "json", work;
+	vector<unsigned long long> sizes;
+	unsigned int runs = 1;
+	measurement best, result;
+	double checkSeconds;
+	char workTemplate[] = "/tmp/compilebenchXXXXXX";
+
+	settings.seed = 1;
+	settings.constants = 20;
+	settings.variables = 40;
+	settings.depth = 3;
+	settings.statements = 0;
+	settings.nesting = 3;
+	settings.literals = 0.3;
+	settings.errors = 0;
+	settings.size = 1024;
+
+	for (int i = 1; i < argc; i += 1)
+	{
+		option = argv[i];
+
+		if (option.substr(0, 7) == "--seed=")
+			settings.seed = strtoull(option.substr(7).c_str(), NULL, 10);
+		else if (option.substr(0, 12) == "--constants=")
+			settings.constants = atoi(option.substr(12).c_str());
+		else if (option.substr(0, 12) == "--variables=")
+			settings.variables = atoi(option.substr(12).c_str());
+		else if (option.substr(0, 8) == "--depth=")
+			settings.depth = atoi(option.substr(8).c_str());
+		else if (option.substr(0, 13) == "--statements=")
+			settings.statements = strtoull(option.substr(13).c_str(), NULL, 10);
+		else if (option.substr(0, 10) == "--nesting=")
+			settings.nesting = atoi(option.substr(10).c_str());
+		else if (option.substr(0, 11) == "--literals=")
+			settings.literals = atof(option.substr(11).c_str());
+		else if (option.substr(0, 9) == "--errors=")
+			settings.errors = atof(option.substr(9).c_str());
+		else if (option.substr(0, 7) == "--size=")
+			settings.size = ParseSize(option.substr(7));
+		else if (option.substr(0, 11) == "--generate=")
+			generateName = option.substr(11);
+		else if (option.substr(0, 8) == "--sizes=")
+		{
+			stringstream list(option.substr(8));
+			string size;
+			while (getline(list, size, ','))
+				sizes.push_back(ParseSize(size));
+		}
+		else if (option.substr(0, 11) == "--compiler=")
+			compiler = option.substr(11);
+		else if (option.substr(0, 7) == "--runs=")
+			runs = atoi(option.substr(7).c_str());
+		else if (option.substr(0, 9) == "--format=")
+			format = option.substr(9);
+		else
+		{
+			cerr << "usage: " << argv[0] << " [--seed=n] [--constants=n] [--variables=n] [--depth=n]\n"
+			     << "       [--statements=n] [--nesting=n] [--literals=p] [--errors=p]\n"
+			     << "       (--generate=file [--size=bytes] | [--sizes=list] [--compiler=path]\n"
+			     << "       [--runs=n] [--format=json|tsv])\n";
+			return 1;
+		}
+	}
+
+	if (settings.variables < 2)
+		settings.variables = 2;
+	if (settings.constants < 2)
+		settings.constants = 2;
+
+	if (generateName != "")
+	{
+		GenerateProgram(generateName);
+		cerr << byteCount << " bytes, " << lineCount << " lines, " << tokenCount << " tokens\n";
+		return 0;
+	}
+
+	if (sizes.empty())
+	{
+		sizes.push_back(ParseSize("1K"));
+		sizes.push_back(ParseSize("10K"));
+		sizes.push_back(ParseSize("100K"));
+		sizes.push_back(ParseSize("1M"));
+		sizes.push_back(ParseSize("10M"));
+		sizes.push_back(ParseSize("100M"));
+	}
+
+	if (mkdtemp(workTemplate) == NULL)
+	{
+		cerr << "cannot create a work directory\n";
+		return 1;
+	}
+	work = workTemplate;
+
+	if (format == "tsv")
+		cout << "size\tbytes\tlines\ttokens\tseconds\tparse_seconds\tlines_per_second\t"
+		     << "tokens_per_second\tpeak_rss_kb\tstatus\tcheck_seconds\tcheck_speedup\n";
+	else
+		cout << "[\n";
+
+	// Every size gets the same seed, so a size always yields the same program
+	for (unsigned int i = 0; i < sizes.size(); i += 1)
+	{
+		settings.size = sizes[i];
+		GenerateProgram(work + "/program.pas");
+
+		for (unsigned int run = 0; run < runs; run += 1)
+		{
+			result = Compile(compiler, work + "/program.pas", work, sizes[i]);
+			if (run == 0 || result.seconds < best.seconds)
+				best = result;
+		}
+		for (unsigned int run = 0; run < runs; run += 1)
+		{
+			checkSeconds = Check(compiler, work + "/program.pas", work);
+			if (run == 0 || checkSeconds < best.checkSeconds)
+				best.checkSeconds = checkSeconds;
+		}
+
+		WriteMeasurement(best, format, i == 0);
+	}
+
+	if (format != "tsv")
+		cout << "\n]\n";
+
+	unlink((work + "/program.pas").c_str());
+	unlink((work + "/program.lst").c_str());
+	unlink((work + "/program.obj").c_str());
+	unlink((work + "/program.err").c_str());
+	rmdir(work.c_str());
+
+	return 0;
+}
+
+// Returns a random number below n. The raw generator is used, as the
+// distributions of the standard library differ between implementations.
+unsigned int Random(unsigned int n)
+{
+	return generator() % n;
+}
+
+// Returns true with probability p
+bool Chance(double p)
+{
+	return (generator() >> 11) * (1.0 / 9007199254740992.0) < p;
+}
+
+// Append a token to the current line
+void Put(string token)
+{
+	char last = currentLine.empty() ? ' ' : currentLine[currentLine.length() - 1];
+
+	if (last != ' ' && last != '(' && token != ")" && token != ";" && token != "," && token != ".")
+		currentLine += " ";
+	currentLine += token;
+	tokenCount += 1;
+}
+
+// Write the current line and start the next one indented
+void NewLine(unsigned int indent)
+{
+	programFile << currentLine << "\n";
+	byteCount += currentLine.length() + 1;
+	lineCount += 1;
+	currentLine = string(indent, ' ');
+}
+
+// Returns an integer variable, constant or literal
+string IntegerLeaf()
+{
+	if (Chance(settings.literals))
+		return to_string(Random(1000));
+	if (Random(4) == 0)
+		return "k" + to_string(Random(settings.constants / 2));
+	return "n" + to_string(Random(settings.variables / 2));
+}
+
+// Returns a boolean variable, constant or literal. The compiler can take the
+// negation of a literal inside a larger expression for an undefined constant,
+// so literals only stand alone.
+string BooleanLeaf(bool alone)
+{
+	if (alone && Chance(settings.literals))
+		return Random(2) == 0 ? "false" : "true";
+	if (Random(4) == 0)
+		return "c" + to_string(Random(settings.constants - settings.constants / 2));
+	return "b" + to_string(Random(settings.variables - settings.variables / 2));
+}
+
+// Write an integer expression at most depth operators deep. Operands that
+// are expressions themselves are parenthesized.
+void IntegerExpression(unsigned int depth)
+{
+	static const string operators[] = {"+", "-", "*", "div", "mod"};
+	unsigned int choice = depth == 0 ? 0 : Random(6);
+
+	if (choice <= 1)
+	{
+		Put(IntegerLeaf());
+	}
+	else if (choice == 2)
+	{
+		Put("-");
+		Put("(");
+		IntegerExpression(depth - 1);
+		Put(")");
+	}
+	else
+	{
+		Put("(");
+		IntegerExpression(depth - 1);
+		Put(")");
+		Put(operators[Random(5)]);
+		Put("(");
+		IntegerExpression(depth - 1);
+		Put(")");
+	}
+}
+
+// Write a boolean expression at most depth operators deep
+void BooleanExpression(unsigned int depth)
+{
+	static const string relations[] = {"=", "<>", "<", "<=", ">", ">="};
+	static const string operators[] = {"and", "or", "="};
+	unsigned int choice = depth == 0 ? 0 : Random(5);
+
+	if (choice == 0)
+	{
+		Put(BooleanLeaf(depth == settings.depth));
+	}
+	else if (choice <= 2)
+	{
+		Put("(");
+		IntegerExpression(depth - 1);
+		Put(")");
+		Put(relations[Random(6)]);
+		Put("(");
+		IntegerExpression(depth - 1);
+		Put(")");
+	}
+	else if (choice == 3)
+	{
+		Put("not");
+		Put("(");
+		BooleanExpression(depth - 1);
+		Put(")");
+	}
+	else
+	{
+		Put("(");
+		BooleanExpression(depth - 1);
+		Put(")");
+		Put(operators[Random(3)]);
+		Put("(");
+		BooleanExpression(depth - 1);
+		Put(")");
+	}
+}
+
+// Write one statement. Statements nest if, while, repeat and begin-end up
+// to the nesting limit. The compiler does not accept an if right after then,
+// even inside a while, so there an if is put inside begin and end.
+void Statement(unsigned int indent, unsigned int nesting, bool allowIf)
+{
+	unsigned int choice = Random(nesting < settings.nesting ? 20 : 14), count;
+	
+	if (!allowIf && choice >= 14 && choice < 16)
+		choice = 19;
+
+	if (choice < 7)
+	{
+		Put("n" + to_string(Random(settings.variables / 2)));
+		Put(":=");
+		IntegerExpression(settings.depth);
+		// An operator without its right operand is an error
+		if (settings.errors > 0 && Chance(settings.errors))
+			Put("+");
+		Put(";");
+	}
+	else if (choice < 10)
+	{
+		Put("b" + to_string(Random(settings.variables - settings.variables / 2)));
+		Put(":=");
+		BooleanExpression(settings.depth);
+		Put(";");
+	}
+	else if (choice < 14)
+	{
+		Put(choice < 11 ? "read" : "write");
+		Put("(");
+		count = 1 + Random(3);
+		for (unsigned int i = 0; i < count; i += 1)
+		{
+			if (i > 0)
+				Put(",");
+			if (Random(2) == 0)
+				Put("n" + to_string(Random(settings.variables / 2)));
+			else
+				Put("b" + to_string(Random(settings.variables - settings.variables / 2)));
+		}
+		Put(")");
+		Put(";");
+	}
+	else if (choice < 16)
+	{
+		Put("if");
+		BooleanExpression(settings.depth);
+		Put("then");
+		NewLine(indent + 2);
+		Statement(indent + 2, nesting + 1, false);
+		if (Random(2) == 0)
+		{
+			NewLine(indent);
+			Put("else");
+			NewLine(indent + 2);
+			Statement(indent + 2, nesting + 1, true);
+		}
+	}
+	else if (choice < 18)
+	{
+		Put("while");
+		BooleanExpression(settings.depth);
+		Put("do");
+		NewLine(indent + 2);
+		Statement(indent + 2, nesting + 1, allowIf);
+	}
+	else if (choice < 19)
+	{
+		Put("repeat");
+		count = 1 + Random(3);
+		for (unsigned int i = 0; i < count; i += 1)
+		{
+			NewLine(indent + 2);
+			Statement(indent + 2, nesting + 1, true);
+		}
+		NewLine(indent);
+		Put("until");
+		BooleanExpression(settings.depth);
+		Put(";");
+	}
+	else
+	{
+		Put("begin");
+		count = 1 + Random(4);
+		for (unsigned int i = 0; i < count; i += 1)
+		{
+			NewLine(indent + 2);
+			Statement(indent + 2, nesting + 1, true);
+		}
+		NewLine(indent);
+		Put("end");
+		Put(";");
+	}
+}
+
+// Write a program with the current settings. Without a statement count,
+// statements are added until the program reaches the requested size.
+void GenerateProgram(string fileName)
+{
+	unsigned int integers = settings.constants / 2;
+	unsigned long long statements = 0;
+
+	generator.seed(settings.seed);
+	programFile.open(fileName.c_str());
+	currentLine = "";
+	lineCount = 0;
+	tokenCount = 0;
+	byteCount = 0;
+
+	Put("program");
+	Put("generated");
+	Put(";");
+	NewLine(0);
+
+	Put("const");
+	NewLine(2);
+	for (unsigned int i = 0; i < settings.constants; i += 1)
+	{
+		if (i < integers)
+		{
+			Put("k" + to_string(i));
+			Put("=");
+			Put(Random(4) == 0 ? "-" + to_string(Random(1000)) : to_string(Random(1000)));
+		}
+		else
+		{
+			Put("c" + to_string(i - integers));
+			Put("=");
+			Put(Random(2) == 0 ? "true" : "false");
+		}
+		Put(";");
+		NewLine(i + 1 < settings.constants ? 2 : 0);
+	}
+
+	// Variables are declared ten to a line
+	Put("var");
+	NewLine(2);
+	for (unsigned int i = 0; i < settings.variables / 2; i += 1)
+	{
+		if (i > 0 && i % 10 == 0)
+		{
+			Put(":");
+			Put("integer");
+			Put(";");
+			NewLine(2);
+		}
+		if (i % 10 != 0)
+			Put(",");
+		Put("n" + to_string(i));
+	}
+	Put(":");
+	Put("integer");
+	Put(";");
+	NewLine(2);
+	for (unsigned int i = 0; i < settings.variables - settings.variables / 2; i += 1)
+	{
+		if (i > 0 && i % 10 == 0)
+		{
+			Put(":");
+			Put("boolean");
+			Put(";");
+			NewLine(2);
+		}
+		if (i % 10 != 0)
+			Put(",");
+		Put("b" + to_string(i));
+	}
+	Put(":");
+	Put("boolean");
+	Put(";");
+	NewLine(0);
+
+	Put("begin");
+	NewLine(2);
+	while ((settings.statements > 0 && statements < settings.statements) ||
+	       (settings.statements == 0 && (statements == 0 || byteCount + 5 < settings.size)))
+	{
+		Statement(2, 0, true);
+		NewLine(2);
+		statements += 1;
+	}
+	currentLine = "";
+	Put("end");
+	Put(".");
+	NewLine(0);
+
+	programFile.close();
+}
+
+// Compile a program, with an unlimited stack as deep programs recurse
+// deeply, and measure the wall time, the parse time the compiler reports
+// with --time-passes, and the peak resident memory
+measurement Compile(string compiler, string fileName, string work, unsigned long long size)
+{
+	measurement result;
+	struct rusage usage;
+	struct rlimit stack;
+	chrono::steady_clock::time_point start;
+	string listing = work + "/program.lst", object = work + "/program.obj";
+	string errors = work + "/program.err", line;
+	int status, descriptor;
+	pid_t child;
+
+	result.size = size;
+	result.bytes = byteCount;
+	result.lines = lineCount;
+	result.tokens = tokenCount;
+	result.parseSeconds = 0;
+
+	start = chrono::steady_clock::now();
+	child = fork();
+	if (child == 0)
+	{
+		stack.rlim_cur = RLIM_INFINITY;
+		stack.rlim_max = RLIM_INFINITY;
+		setrlimit(RLIMIT_STACK, &stack);
+
+		descriptor = open(errors.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		dup2(descriptor, 2);
+		// Erroneous programs are compiled with no error limit, so every
+		// error is recovered from
+		if (settings.errors > 0)
+			execl(compiler.c_str(), compiler.c_str(), "-O0", "--time-passes", "--max-errors=0",
+			      fileName.c_str(), listing.c_str(), object.c_str(), (char *) NULL);
+		else
+			execl(compiler.c_str(), compiler.c_str(), "-O0", "--time-passes", fileName.c_str(),
+			      listing.c_str(), object.c_str(), (char *) NULL);
+		_exit(127);
+	}
+
+	wait4(child, &status, 0, &usage);
+	result.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+	result.peakKilobytes = usage.ru_maxrss;
+	result.status = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+
+	ifstream report(errors.c_str());
+	while (getline(report, line))
+	{
+		if (line.substr(0, 6) == "parse ")
+			result.parseSeconds = atof(line.substr(6).c_str());
+	}
+
+	return result;
+}
+
+// Time --check of a program, with the same stack and error limit as Compile
+double Check(string compiler, string fileName, string work)
+{
+	struct rlimit stack;
+	chrono::steady_clock::time_point start;
+	string errors = work + "/program.err";
+	int status, descriptor;
+	pid_t child;
+
+	start = chrono::steady_clock::now();
+	child = fork();
+	if (child == 0)
+	{
+		stack.rlim_cur = RLIM_INFINITY;
+		stack.rlim_max = RLIM_INFINITY;
+		setrlimit(RLIMIT_STACK, &stack);
+
+		descriptor = open(errors.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		dup2(descriptor, 2);
+		if (settings.errors > 0)
+			execl(compiler.c_str(), compiler.c_str(), "--check", "--max-errors=0", fileName.c_str(), (char *) NULL);
+		else
+			execl(compiler.c_str(), compiler.c_str(), "--check", fileName.c_str(), (char *) NULL);
+		_exit(127);
+	}
+
+	waitpid(child, &status, 0);
+	return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+// Returns a size given in bytes, or with a K, M or G suffix
+unsigned long long ParseSize(string text)
+{
+	unsigned long long size = strtoull(text.c_str(), NULL, 10);
+
+	if (text != "" && (text[text.length() - 1] == 'K' || text[text.length() - 1] == 'k'))
+		size *= 1024;
+	else if (text != "" && (text[text.length() - 1] == 'M' || text[text.length() - 1] == 'm'))
+		size *= 1024 * 1024;
+	else if (text != "" && (text[text.length() - 1] == 'G' || text[text.length() - 1] == 'g'))
+		size *= 1024 * 1024 * 1024;
+
+	return size;
+}
+
+// Write one measurement as a JSON object or a tab separated line
+void WriteMeasurement(measurement result, string format, bool first)
+{
+	double seconds = result.seconds > 0 ? result.seconds : 1e-9;
+	double checkSeconds = result.checkSeconds > 0 ? result.checkSeconds : 1e-9;
+
+	cout << fixed;
+	if (format == "tsv")
+	{
+		cout << result.size << "\t" << result.bytes << "\t" << result.lines << "\t" << result.tokens << "\t"
+		     << setprecision(6) << result.seconds << "\t" << result.parseSeconds << "\t"
+		     << setprecision(0) << result.lines / seconds << "\t" << result.tokens / seconds << "\t"
+		     << result.peakKilobytes << "\t" << result.status << "\t"
+		     << setprecision(6) << result.checkSeconds << "\t" << setprecision(2) << result.seconds / checkSeconds << "\n";
+	}
+	else
+	{
+		cout << (first ? "" : ",\n")
+		     << "  {\"size\": " << result.size << ", \"bytes\": " << result.bytes
+		     << ", \"lines\": " << result.lines << ", \"tokens\": " << result.tokens
+		     << setprecision(6) << ", \"seconds\": " << result.seconds
+		     << ", \"parse_seconds\": " << result.parseSeconds
+		     << setprecision(0) << ", \"lines_per_second\": " << result.lines / seconds
+		     << ", \"tokens_per_second\": " << result.tokens / seconds
+		     << ", \"peak_rss_kb\": " << result.peakKilobytes << ", \"status\": " << result.status
+		     << setprecision(6) << ", \"check_seconds\": " << result.checkSeconds
+		     << setprecision(2) << ", \"check_speedup\": " << result.seconds / checkSeconds << "}";
+	}
+	cout.flush();
+}
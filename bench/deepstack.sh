@@ -0,0 +1,58 @@
+#!/bin/sh
+# Compile a program of one million sequential statements, preceded by long
+# constant, variable and identifier lists and followed by an expression of
+# 50000 operands and one nested 20000 parentheses deep, under a small stack
+# limit. Statement and declaration lists are parsed in loops and expressions
+# with an explicit stack, so only the nesting of statements may deepen the
+# parser's stack.
+# usage: bench/deepstack.sh [statements] [stack-kb]
+set -e
+
+statements=${1:-1000000}
+stack=${2:-256}
+work=${TMPDIR:-/tmp}/pascallite-deepstack.$$
+mkdir -p "$work"
+trap 'rm -rf "$work"' EXIT
+
+g++ -O2 -o "$work/stage02" stage02.cpp
+
+awk -v statements="$statements" 'BEGIN {
+	print "program deep;"
+	print "const"
+	for (i = 0; i < 10000; i += 1)
+		print "  c" i " = " i % 100 ";"
+	printf "var a"
+	for (i = 0; i < 10000; i += 1)
+		printf ", v%d", i
+	print " : integer;"
+	for (i = 0; i < 10000; i += 1)
+		print "  w" i " : boolean;"
+	print "begin"
+	print "  read(a);"
+	for (i = 0; i < statements; i += 1)
+		print "  v" i % 10000 " := a + c" i % 10000 ";"
+	printf "  a := a"
+	for (i = 1; i < 50000; i += 1)
+		printf " + a"
+	print ";"
+	printf "  a := "
+	for (i = 0; i < 20000; i += 1)
+		printf "("
+	printf "a"
+	for (i = 0; i < 20000; i += 1)
+		printf " - 1)"
+	print ";"
+	print "  write(a);"
+	print "end."
+}' > "$work/deep.pas"
+
+for level in -O0 -O1
+do
+	if (ulimit -s "$stack" && "$work/stage02" "$level" "$work/deep.pas" "$work/deep.lst" "$work/deep.obj")
+	then
+		echo "$level: $statements statements compiled with a ${stack}K stack"
+	else
+		echo "$level: $statements statements failed with a ${stack}K stack"
+		exit 1
+	fi
+done
@@ -0,0 +1,40 @@
+#!/bin/sh
+# Compile each Pascallite program for the RAMM and through --target=c, run
+# both on the same input and report the programs whose standard outputs
+# differ.
+# usage: bench/differential.sh input program.pas...
+set -e
+
+input=$1
+shift
+work=${TMPDIR:-/tmp}/pascallite-differential.$$
+mkdir -p "$work"
+trap 'rm -rf "$work"' EXIT
+
+g++ -O2 -o "$work/stage02" stage02.cpp
+g++ -O2 -o "$work/ramm" ramm.cpp
+
+status=0
+for program in "$@"
+do
+	if ! "$work/stage02" "$program" "$work/ramm.lst" "$work/program.obj"
+	then
+		echo "skipped $program: compilation errors"
+		continue
+	fi
+	"$work/stage02" --target=c "$program" "$work/c.lst" "$work/program.c"
+	cc -O2 -o "$work/program" "$work/program.c"
+
+	echo "$input" | "$work/ramm" "$work/program.obj" > "$work/ramm.out" 2> /dev/null || true
+	echo "$input" | "$work/program" > "$work/c.out" 2> /dev/null || true
+
+	if cmp -s "$work/ramm.out" "$work/c.out"
+	then
+		echo "same      $program"
+	else
+		echo "differs   $program"
+		status=1
+	fi
+done
+
+exit $status
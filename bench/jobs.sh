@@ -0,0 +1,32 @@
+#!/bin/sh
+# Compile one large generated program with 1, 2, 4 and 8 jobs at -O2, print
+# the wall time of each compile and check that every object file is the same
+# as the one written by a single job.
+# usage: bench/jobs.sh [size] [jobs...]
+set -e
+
+size=${1:-50M}
+shift 2> /dev/null || true
+jobs=${*:-1 2 4 8}
+work=${TMPDIR:-/tmp}/pascallite-jobs.$$
+mkdir -p "$work"
+trap 'rm -rf "$work"' EXIT
+
+g++ -O2 -o "$work/stage02" stage02.cpp
+g++ -O2 -o "$work/compilebench" bench/compilebench.cpp
+"$work/compilebench" --generate="$work/program.pas" --size="$size"
+
+"$work/stage02" -O2 --jobs=1 "$work/program.pas" "$work/program.lst" "$work/expected.obj"
+for n in $jobs
+do
+	start=$(date +%s.%N)
+	"$work/stage02" -O2 --jobs="$n" "$work/program.pas" "$work/program.lst" "$work/program.obj"
+	end=$(date +%s.%N)
+	if cmp -s "$work/expected.obj" "$work/program.obj"
+	then
+		printf '%2d jobs %10.3f s\n' "$n" "$(echo "$start $end" | awk '{ print $2 - $1 }')"
+	else
+		echo "$n jobs: object code differs from 1 job"
+		exit 1
+	fi
+done
@@ -0,0 +1,25 @@
+program arithmetic;
+const
+  base = 10;
+  modulus = 9973;
+var
+  n, i, x, digits, total, rest : integer;
+begin
+  read(n);
+  total := 0;
+  i := 1;
+  while i <= n do
+  begin
+    x := i * i + 7;
+    digits := 0;
+    repeat
+      rest := x mod base;
+      digits := digits + rest;
+      x := x div base;
+    until x = 0;
+    total := (total * 31 + digits) mod modulus;
+    total := total - total div 7 * 7 + i mod 13;
+    i := i + 1;
+  end;
+  write(total);
+end.
@@ -0,0 +1,29 @@
+program branches;
+var
+  n, i, small, medium, large, odd : integer;
+begin
+  read(n);
+  small := 0;
+  medium := 0;
+  large := 0;
+  odd := 0;
+  i := 0;
+  while i < n do
+  begin
+    if i < 10 then
+      small := small + 1;
+    else
+    begin
+      if i < 100 then
+        medium := medium + 1;
+      else
+        large := large + 1;
+    end;
+    if i mod 2 = 1 then
+    begin
+      if i mod 3 = 0 then odd := odd + 3; else odd := odd + 1;
+    end;
+    i := i + 1;
+  end;
+  write(small, medium, large, odd);
+end.
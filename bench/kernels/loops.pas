@@ -0,0 +1,25 @@
+program loops;
+var
+  n, i, j, sum, count : integer;
+begin
+  read(n);
+  sum := 0;
+  count := 0;
+  i := 0;
+  while i < n do
+  begin
+    j := i;
+    while j < n do
+    begin
+      sum := sum + i * j;
+      count := count + 1;
+      j := j + 1;
+    end;
+    i := i + 1;
+  end;
+  repeat
+    sum := sum - n;
+    i := i - 1;
+  until i <= 0;
+  write(sum, count);
+end.
@@ -0,0 +1,21 @@
+program predicates;
+var
+  n, i, hits : integer;
+  even, third, fifth, inside, pick : boolean;
+begin
+  read(n);
+  hits := 0;
+  i := 0;
+  while (i < n) and not (i = 1000) do
+  begin
+    even := i mod 2 = 0;
+    third := i mod 3 = 0;
+    fifth := i mod 5 = 0;
+    inside := (i > 10) and (i < n - 10);
+    pick := (even or third) and not fifth or (inside and (even <> third));
+    if pick then hits := hits + 1;
+    if not pick and (even = fifth) then hits := hits + 2;
+    i := i + 1;
+  end;
+  write(hits);
+end.
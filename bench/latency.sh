@@ -0,0 +1,44 @@
+#!/bin/sh
+# Compare the time from starting a Pascallite program to its output when it
+# is run directly with --run and when it is compiled to RAMM object code and
+# then simulated.
+# usage: bench/latency.sh [program.pas] [input] [runs]
+set -e
+
+program=${1:-bench/loop.pas}
+input=${2:-10}
+runs=${3:-20}
+work=${TMPDIR:-/tmp}/pascallite-latency.$$
+mkdir -p "$work"
+trap 'rm -rf "$work"' EXIT
+
+g++ -O2 -o "$work/stage02" stage02.cpp
+g++ -O2 -o "$work/ramm" ramm.cpp
+
+# mean name command: print the mean wall time of runs runs of command
+mean()
+{
+	name=$1
+	shift
+	start=$(date +%s.%N)
+	i=0
+	while [ $i -lt "$runs" ]
+	do
+		sh -c "$*" > "$work/$name.out"
+		i=$((i + 1))
+	done
+	end=$(date +%s.%N)
+	printf '%-22s %10.3f ms\n' "$name" "$(echo "$start $end $runs" | awk '{ print ($2 - $1) * 1000 / $3 }')"
+}
+
+mean run "echo $input | $work/stage02 --run $program"
+mean compile-then-simulate "$work/stage02 $program $work/program.lst $work/program.obj &&
+	echo $input | $work/ramm $work/program.obj"
+
+if ! cmp -s "$work/run.out" "$work/compile-then-simulate.out"
+then
+	echo "outputs differ" >&2
+	exit 1
+fi
+
+echo "$input" | "$work/stage02" --run --time-passes "$program" 2>&1 > /dev/null | grep "first output"
@@ -0,0 +1,19 @@
+program loop;
+var
+  i, j, s, n : integer;
+begin
+  read(n);
+  s := 0;
+  i := 0;
+  while i < n do
+  begin
+    j := 0;
+    while j < n do
+    begin
+      if (i + j) mod 3 = 0 then s := s + i; else s := s - j;
+      j := j + 1;
+    end;
+    i := i + 1;
+  end;
+  write(s);
+end.
@@ -0,0 +1,577 @@
+// Brian Leary
+//Joseph Lynch
+/*
+	This program times the hot paths of the Pascallite compiler in
+	isolation: NextToken on several token mixes, FindIndex and
+	IsNameInSymbolTable at several symbol table sizes, Insert with long comma
+	lists, and Code for every operator on fixed operand shapes. Every
+	benchmark reports nanoseconds, heap allocations and heap bytes per
+	operation, so a change in allocation behavior shows up next to a change
+	in time. The compiler is included as source with its main left out.
+*/
+
+#define STAGE02_NO_MAIN
+#include "../stage02.cpp"
+
+#include <new>
+#include <cstdlib>
+#include <unistd.h>
+
+// Heap allocations and bytes since the program started, counted by the
+// replacement operator new below
+unsigned long long heapAllocations = 0;
+unsigned long long heapBytes = 0;
+
+// Define the measurements of one benchmark
+struct benchResult
+{
+	string name;
+	unsigned long long ops;
+	double seconds;
+	unsigned long long allocations;
+	unsigned long long bytes;
+};
+
+// Benchmark settings and state: the output format, the names to run, the
+// time each benchmark runs for, and the scratch source file of the lexer
+string benchFormat = "table";
+string benchFilter = "";
+double minSeconds = 0.2;
+bool firstResult = true;
+string scratchName = "";
+
+// Parameters of the benchmark being set up
+string lexerText = "";
+unsigned int tableSize = 0;
+vector<string> lookupNames;
+string insertList = "";
+string emitOperator = "";
+string emitOperand1 = "";
+string emitOperand2 = "";
+string emitRegister = "";
+
+// Function prototypes
+void *AllocateBlock(size_t size, size_t alignment);
+void ReleaseBlock(void *block);
+void ResetCompiler();
+void Measure(string name, void (*Setup)(), unsigned long long (*Batch)());
+void WriteResult(benchResult result);
+string LexerMix(string mix);
+void SetupLexer();
+unsigned long long LexerBatch();
+void SetupLookup();
+unsigned long long FindIndexBatch();
+unsigned long long IsNameInSymbolTableBatch();
+void SetupInsert();
+unsigned long long InsertBatch();
+void SetupEmit();
+unsigned long long EmitBatch();
+
+// Count and allocate a block for every replacement operator new. The memory
+// comes from malloc and posix_memalign, so every operator delete can free it.
+// Both stay out of line, so the compiler never sees a block of operator new
+// passed to free.
+__attribute__((noinline)) void *AllocateBlock(size_t size, size_t alignment)
+{
+	void *block = NULL;
+
+	heapAllocations += 1;
+	heapBytes += size;
+	if (size == 0)
+		size = 1;
+	if (alignment <= __STDCPP_DEFAULT_NEW_ALIGNMENT__)
+		block = malloc(size);
+	else if (posix_memalign(&block, alignment, size) != 0)
+		block = NULL;
+	return block;
+}
+
+__attribute__((noinline)) void ReleaseBlock(void *block)
+{
+	free(block);
+}
+
+void *operator new(size_t size)
+{
+	void *block = AllocateBlock(size, 0);
+
+	if (block == NULL)
+		throw bad_alloc();
+	return block;
+}
+
+void *operator new[](size_t size)
+{
+	return operator new(size);
+}
+
+void *operator new(size_t size, const nothrow_t &) noexcept
+{
+	return AllocateBlock(size, 0);
+}
+
+void *operator new[](size_t size, const nothrow_t &) noexcept
+{
+	return AllocateBlock(size, 0);
+}
+
+void *operator new(size_t size, align_val_t alignment)
+{
+	void *block = AllocateBlock(size, (size_t) alignment);
+
+	if (block == NULL)
+		throw bad_alloc();
+	return block;
+}
+
+void *operator new[](size_t size, align_val_t alignment)
+{
+	return operator new(size, alignment);
+}
+
+void *operator new(size_t size, align_val_t alignment, const nothrow_t &) noexcept
+{
+	return AllocateBlock(size, (size_t) alignment);
+}
+
+void *operator new[](size_t size, align_val_t alignment, const nothrow_t &) noexcept
+{
+	return AllocateBlock(size, (size_t) alignment);
+}
+
+void operator delete(void *block) noexcept
+{
+	ReleaseBlock(block);
+}
+
+void operator delete[](void *block) noexcept
+{
+	ReleaseBlock(block);
+}
+
+void operator delete(void *block, size_t) noexcept
+{
+	ReleaseBlock(block);
+}
+
+void operator delete[](void *block, size_t) noexcept
+{
+	ReleaseBlock(block);
+}
+
+void operator delete(void *block, const nothrow_t &) noexcept
+{
+	ReleaseBlock(block);
+}
+
+void operator delete[](void *block, const nothrow_t &) noexcept
+{
+	ReleaseBlock(block);
+}
+
+void operator delete(void *block, align_val_t) noexcept
+{
+	ReleaseBlock(block);
+}
+
+void operator delete[](void *block, align_val_t) noexcept
+{
+	ReleaseBlock(block);
+}
+
+void operator delete(void *block, size_t, align_val_t) noexcept
+{
+	ReleaseBlock(block);
+}
+
+void operator delete[](void *block, size_t, align_val_t) noexcept
+{
+	ReleaseBlock(block);
+}
+
+void operator delete(void *block, align_val_t, const nothrow_t &) noexcept
+{
+	ReleaseBlock(block);
+}
+
+void operator delete[](void *block, align_val_t, const nothrow_t &) noexcept
+{
+	ReleaseBlock(block);
+}
+
+int main(int argc, char **argv)
+{
+	// Usage: microbench [--filter=text] [--min-time=seconds] [--format=table|json|tsv]
+	string option, mixes[] = {"identifiers", "numbers", "operators", "keywords", "comments", "mixed"};
+	string operators[] = {"+", "-", "*", "div", "mod", "neg", "not", "and", "or", "=", "<>",
+	                      "<", "<=", ">", ">=", ":=", "read", "write"};
+	unsigned int sizes[] = {16, 256, 4096, 65536};
+	unsigned int lists[] = {10, 100, 1000};
+	char scratchTemplate[] = "/tmp/microbenchXXXXXX";
+	int scratch;
+
+	for (int i = 1; i < argc; i += 1)
+	{
+		option = argv[i];
+
+		if (option.substr(0, 9) == "--filter=")
+			benchFilter = option.substr(9);
+		else if (option.substr(0, 11) == "--min-time=")
+			minSeconds = atof(option.substr(11).c_str());
+		else if (option.substr(0, 9) == "--format=" &&
+		         (option.substr(9) == "table" || option.substr(9) == "json" || option.substr(9) == "tsv"))
+			benchFormat = option.substr(9);
+		else
+		{
+			cerr << "usage: " << argv[0] << " [--filter=text] [--min-time=seconds] [--format=table|json|tsv]\n";
+			return 1;
+		}
+	}
+
+	scratch = mkstemp(scratchTemplate);
+	if (scratch == -1)
+	{
+		cerr << "cannot create a scratch file\n";
+		return 1;
+	}
+	close(scratch);
+	scratchName = scratchTemplate;
+
+	// The listing echo is part of the lexer's cost, so it is written, but
+	// nowhere
+	listingFile.open("/dev/null");
+	objectFile.open("/dev/null");
+	symbolTable.resize(INITIAL_SYMBOL_TABLE_SIZE);
+
+	if (benchFormat == "tsv")
+		cout << "name\tops\tns_per_op\tallocs_per_op\tbytes_per_op\n";
+	else if (benchFormat == "json")
+		cout << "[\n";
+	else
+		cout << left << setw(40) << "benchmark" << right << setw(14) << "ops" << setw(12) << "ns/op"
+		     << setw(12) << "allocs/op" << setw(12) << "bytes/op" << "\n";
+
+	for (unsigned int i = 0; i < sizeof(mixes) / sizeof(mixes[0]); i += 1)
+	{
+		lexerText = LexerMix(mixes[i]);
+		Measure("lexer/NextToken/" + mixes[i], SetupLexer, LexerBatch);
+	}
+
+	for (unsigned int i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i += 1)
+	{
+		tableSize = sizes[i];
+		lookupNames.clear();
+		for (unsigned int j = 0; j < 1024; j += 1)
+			lookupNames.push_back("v" + to_string(j * 7919 % tableSize));
+		Measure("symbols/FindIndex/hit/" + to_string(tableSize), SetupLookup, FindIndexBatch);
+		Measure("symbols/IsNameInSymbolTable/hit/" + to_string(tableSize), SetupLookup, IsNameInSymbolTableBatch);
+
+		lookupNames.clear();
+		for (unsigned int j = 0; j < 1024; j += 1)
+			lookupNames.push_back("w" + to_string(j));
+		Measure("symbols/IsNameInSymbolTable/miss/" + to_string(tableSize), SetupLookup, IsNameInSymbolTableBatch);
+	}
+
+	for (unsigned int i = 0; i < sizeof(lists) / sizeof(lists[0]); i += 1)
+	{
+		insertList = "";
+		for (unsigned int j = 0; j < lists[i]; j += 1)
+			insertList += (j == 0 ? "a" : ",a") + to_string(j);
+		Measure("symbols/Insert/list/" + to_string(lists[i]), SetupInsert, InsertBatch);
+	}
+
+	// Two operand shapes: both operands in memory, and the left operand
+	// already in the A register
+	for (unsigned int i = 0; i < sizeof(operators) / sizeof(operators[0]); i += 1)
+	{
+		emitOperator = operators[i];
+		if (emitOperator == "neg")
+		{
+			emitOperand1 = "a";
+			emitOperand2 = "";
+		}
+		else if (emitOperator == "not")
+		{
+			emitOperand1 = "p";
+			emitOperand2 = "";
+		}
+		else if (emitOperator == "and" || emitOperator == "or")
+		{
+			emitOperand1 = "p";
+			emitOperand2 = "q";
+		}
+		else if (emitOperator == "read" || emitOperator == "write")
+		{
+			emitOperand1 = "a,b,c";
+			emitOperand2 = "";
+		}
+		else if (emitOperator == ":=")
+		{
+			emitOperand1 = "a";
+			emitOperand2 = "c";
+		}
+		else
+		{
+			emitOperand1 = "a";
+			emitOperand2 = "b";
+		}
+
+		emitRegister = "";
+		Measure("emit/Code/" + emitOperator + "/memory", SetupEmit, EmitBatch);
+		if (emitOperand2 != "" && emitOperator != ":=")
+		{
+			emitRegister = emitOperand2;
+			Measure("emit/Code/" + emitOperator + "/register", SetupEmit, EmitBatch);
+		}
+	}
+
+	if (benchFormat == "json")
+		cout << "\n]\n";
+
+	sourceFile.close();
+	unlink(scratchName.c_str());
+
+	return 0;
+}
+
+// Empty the symbol table, the object code and the stacks, as if no program
+// had been compiled. The capacity of the tables is kept.
+void ResetCompiler()
+{
+	symbolTable.assign(INITIAL_SYMBOL_TABLE_SIZE, entry());
+	symbolCount = 0;
+	symbolIndex.clear();
+	indexOfTrue = -1;
+	indexOfFalse = -1;
+	integerCount = 0;
+	booleanCount = 0;
+	objectCode.clear();
+	while (!operandStk.empty())
+		operandStk.pop();
+	while (!operatorStk.empty())
+		operatorStk.pop();
+	currentARegister = "";
+	currentTempNo = -1;
+	maxTempNo = -1;
+	currentLabelNo = -1;
+	lineNumber = 0;
+	printLineNumber = false;
+}
+
+// Run the batch until it has taken minSeconds, setting up before every
+// batch. Only the batches are timed and only their allocations counted.
+void Measure(string name, void (*Setup)(), unsigned long long (*Batch)())
+{
+	benchResult result;
+	unsigned long long allocations, bytes;
+	chrono::steady_clock::time_point start;
+
+	if (name.find(benchFilter) == string::npos)
+		return;
+
+	result.name = name;
+	result.ops = 0;
+	result.seconds = 0;
+	result.allocations = 0;
+	result.bytes = 0;
+
+	while (result.seconds < minSeconds || result.ops == 0)
+	{
+		Setup();
+		allocations = heapAllocations;
+		bytes = heapBytes;
+		start = chrono::steady_clock::now();
+		result.ops += Batch();
+		result.seconds += chrono::duration<double>(chrono::steady_clock::now() - start).count();
+		result.allocations += heapAllocations - allocations;
+		result.bytes += heapBytes - bytes;
+	}
+
+	WriteResult(result);
+}
+
+// Write one result as a table row, a tab separated line or a JSON object
+void WriteResult(benchResult result)
+{
+	double nanoseconds = result.seconds * 1e9 / result.ops;
+	double allocations = (double) result.allocations / result.ops;
+	double bytes = (double) result.bytes / result.ops;
+
+	cout << fixed;
+	if (benchFormat == "tsv")
+	{
+		cout << result.name << "\t" << result.ops << "\t" << setprecision(1) << nanoseconds << "\t"
+		     << setprecision(2) << allocations << "\t" << bytes << "\n";
+	}
+	else if (benchFormat == "json")
+	{
+		cout << (firstResult ? "" : ",\n")
+		     << "  {\"name\": \"" << result.name << "\", \"ops\": " << result.ops
+		     << setprecision(1) << ", \"ns_per_op\": " << nanoseconds
+		     << setprecision(2) << ", \"allocs_per_op\": " << allocations
+		     << ", \"bytes_per_op\": " << bytes << "}";
+	}
+	else
+	{
+		cout << left << setw(40) << result.name << right << setw(14) << result.ops
+		     << setprecision(1) << setw(12) << nanoseconds
+		     << setprecision(2) << setw(12) << allocations << setw(12) << bytes << "\n";
+	}
+	firstResult = false;
+	cout.flush();
+}
+
+// Returns about 4096 tokens of the mix, with a few tokens per line
+string LexerMix(string mix)
+{
+	string text = "", words[] = {"program", "const", "var", "begin", "end", "integer", "boolean",
+	                             "read", "write", "if", "then", "else", "while", "do", "repeat",
+	                             "until", "div", "mod", "and", "or", "not", "true", "false"};
+	string symbols[] = {":=", "+", "-", "*", "(", ")", "=", "<>", "<", "<=", ">", ">=", ";", ",", ":"};
+	unsigned int numberOfWords = sizeof(words) / sizeof(words[0]);
+	unsigned int numberOfSymbols = sizeof(symbols) / sizeof(symbols[0]);
+
+	for (unsigned int i = 0; i < 4096; i += 1)
+	{
+		if (mix == "identifiers")
+			text += "count_" + to_string(i % 97) + "x";
+		else if (mix == "numbers")
+			text += to_string(i * 7919 % 32768);
+		else if (mix == "operators")
+			text += symbols[i % numberOfSymbols];
+		else if (mix == "keywords")
+			text += words[i % numberOfWords];
+		else if (mix == "comments")
+			text += "{ a comment of several words } x";
+		else if (i % 4 == 0)
+			text += "total" + to_string(i % 13);
+		else if (i % 4 == 1)
+			text += symbols[i % numberOfSymbols];
+		else if (i % 4 == 2)
+			text += to_string(i % 1000);
+		else
+			text += words[i % numberOfWords];
+
+		text += (i % 8 == 7) ? "\n" : " ";
+	}
+
+	return text;
+}
+
+// Write the mix to the scratch file and open it as the source
+void SetupLexer()
+{
+	static string written = "";
+
+	if (written != lexerText)
+	{
+		ofstream scratchFile(scratchName.c_str());
+		scratchFile << lexerText;
+		scratchFile.close();
+		written = lexerText;
+		sourceFile.close();
+		sourceFile.open(scratchName.c_str());
+	}
+
+	sourceFile.clear();
+	sourceFile.seekg(0);
+	lineNumber = 0;
+	printLineNumber = false;
+}
+
+// Lex the whole scratch file. One operation is one token.
+unsigned long long LexerBatch()
+{
+	unsigned long long tokens = 0;
+
+	NextChar();
+	while (NextToken() != "$")
+		tokens += 1;
+
+	return tokens;
+}
+
+// Fill the symbol table with tableSize integer variables v0, v1, ...
+void SetupLookup()
+{
+	static unsigned int filled = 0;
+
+	if (filled == tableSize && symbolCount == tableSize)
+		return;
+
+	ResetCompiler();
+	for (unsigned int i = 0; i < tableSize; i += 1)
+		Insert("v" + to_string(i), INTEGER, VARIABLE, "", YES, 1);
+	filled = tableSize;
+}
+
+// Look up every name. One operation is one lookup.
+unsigned long long FindIndexBatch()
+{
+	int sum = 0;
+
+	for (unsigned int i = 0; i < lookupNames.size(); i += 1)
+		sum += FindIndex(lookupNames[i]);
+
+	// Keep the lookups from being optimized away
+	if (sum == -1)
+		cerr << sum;
+
+	return lookupNames.size();
+}
+
+// Test every name. One operation is one test.
+unsigned long long IsNameInSymbolTableBatch()
+{
+	int found = 0;
+
+	for (unsigned int i = 0; i < lookupNames.size(); i += 1)
+		found += IsNameInSymbolTable(lookupNames[i]);
+
+	if (found == -1)
+		cerr << found;
+
+	return lookupNames.size();
+}
+
+// Start from an empty symbol table
+void SetupInsert()
+{
+	ResetCompiler();
+}
+
+// Insert the whole list. One operation is one name.
+unsigned long long InsertBatch()
+{
+	Insert(insertList, INTEGER, VARIABLE, "", YES, 1);
+
+	return symbolCount;
+}
+
+// Declare integers a, b, c and booleans p, q, as Vars would
+void SetupEmit()
+{
+	ResetCompiler();
+	Insert("a,b,c", INTEGER, VARIABLE, "", YES, 1);
+	Insert("p,q", BOOLEAN, VARIABLE, "", YES, 1);
+}
+
+// Generate code for the operator 256 times, freeing its result each time.
+// One operation is one call of Code.
+unsigned long long EmitBatch()
+{
+	for (unsigned int i = 0; i < 256; i += 1)
+	{
+		currentARegister = emitRegister;
+		Code(emitOperator, emitOperand1, emitOperand2);
+
+		while (!operandStk.empty())
+		{
+			if (operandStk.top()[0] == 'T')
+				FreeTemp();
+			operandStk.pop();
+		}
+	}
+
+	return 256;
+}
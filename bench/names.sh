@@ -0,0 +1,88 @@
+#!/bin/sh
+# Compile, assemble and run three programs with many names: one of 100000
+# comparisons with their own literals, each or-ed with the false literal and
+# tested by an if, which needs 300000 labels; one adding 100000 distinct
+# literals; and one expression nested 100000 deep, which needs 100000
+# temporaries. Each must print the expected value at -O0 and -O1, also after
+# being converted to a binary object and back to text.
+# usage: bench/names.sh [count]
+set -e
+
+count=${1:-100000}
+work=${TMPDIR:-/tmp}/pascallite-names.$$
+mkdir -p "$work"
+trap 'rm -rf "$work"' EXIT
+
+g++ -O2 -o "$work/stage02" stage02.cpp
+g++ -O2 -o "$work/ramm" ramm.cpp
+
+awk -v count="$count" 'BEGIN {
+	print "program labels;"
+	print "var a, b : integer;"
+	print "  c : boolean;"
+	print "begin"
+	print "  read(a);"
+	print "  b := 0;"
+	for (i = 0; i < count; i += 1)
+	{
+		print "  c := (a > " i ") or false;"
+		print "  if c then b := b + 1;"
+	}
+	print "  write(b);"
+	print "end."
+}' > "$work/labels.pas"
+
+awk -v count="$count" 'BEGIN {
+	print "program literals;"
+	print "var a, b : integer;"
+	print "begin"
+	print "  read(a);"
+	print "  b := a;"
+	for (i = 1; i <= count; i += 1)
+		print "  b := b + " i ";"
+	print "  write(b);"
+	print "end."
+}' > "$work/literals.pas"
+
+awk -v count="$count" 'BEGIN {
+	print "program temporaries;"
+	print "var a, b : integer;"
+	print "begin"
+	print "  read(a);"
+	printf "  b := "
+	for (i = 1; i < count; i += 1)
+		printf "(a + 1) + ("
+	printf "a + 1"
+	for (i = 1; i < count; i += 1)
+		printf ")"
+	print ";"
+	print "  write(b);"
+	print "end."
+}' > "$work/temporaries.pas"
+
+# run name input expected: compile name at each level, run it as text and as
+# a binary converted back to text, and compare its output with expected
+run()
+{
+	for level in -O0 -O1
+	do
+		"$work/stage02" "$level" "$work/$1.pas" "$work/$1.lst" "$work/$1.obj"
+		"$work/ramm" --write-binary="$work/$1.bin" "$work/$1.obj"
+		"$work/ramm" --write-text="$work/$1.txt" "$work/$1.bin"
+		for object in "$work/$1.obj" "$work/$1.txt"
+		do
+			output=$("$work/ramm" --input="$2" "$object")
+			if [ "$output" != "$3" ]
+			then
+				echo "$1 $level: $(basename "$object") printed $output, expected $3"
+				exit 1
+			fi
+		done
+		echo "$1 $level: $(grep -c '^L' "$work/$1.obj" || true) labels," \
+		     "$(grep -c '^T' "$work/$1.obj" || true) temporaries, printed $3"
+	done
+}
+
+run labels $((count / 2)) $((count / 2))
+run literals 1 $(awk -v count="$count" 'BEGIN { printf "%.0f", 1 + count * (count + 1) / 2 }')
+run temporaries 1 $((2 * count))
@@ -0,0 +1,47 @@
+#!/bin/sh
+# Compare a Pascallite program run natively through --target=x86_64 and
+# --target=c with the same program run on the simulated RAMM.
+# usage: bench/native.sh [program.pas] [input]
+set -e
+
+program=${1:-bench/loop.pas}
+input=${2:-2000}
+work=${TMPDIR:-/tmp}/pascallite-native.$$
+mkdir -p "$work"
+trap 'rm -rf "$work"' EXIT
+
+g++ -O2 -o "$work/stage02" stage02.cpp
+g++ -O2 -o "$work/ramm" ramm.cpp
+
+"$work/stage02" -O2 "$program" "$work/ramm.lst" "$work/program.obj"
+"$work/stage02" -O2 --target=x86_64 "$program" "$work/native.lst" "$work/program.s"
+cc -o "$work/program" "$work/program.s"
+"$work/stage02" --target=c "$program" "$work/c.lst" "$work/program.c"
+cc -O2 -o "$work/program-c" "$work/program.c"
+
+# run name command...: time a run on the input, keeping its output in name.out
+run()
+{
+	name=$1
+	shift
+	start=$(date +%s.%N)
+	echo "$input" | "$@" > "$work/$name.out"
+	end=$(date +%s.%N)
+	printf '%-14s %10.3f s\n' "$name" "$(echo "$start $end" | awk '{ print $2 - $1 }')"
+}
+
+for engine in switch threaded jit
+do
+	run "ramm-$engine" "$work/ramm" --engine=$engine "$work/program.obj"
+done
+run native "$work/program"
+run c "$work/program-c"
+
+for engine in ramm-switch ramm-threaded ramm-jit c
+do
+	if ! cmp -s "$work/$engine.out" "$work/native.out"
+	then
+		echo "output of $engine differs from native" >&2
+		exit 1
+	fi
+done
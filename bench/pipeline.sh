@@ -0,0 +1,48 @@
+#!/bin/sh
+# Compare compiling generated programs of several sizes on one thread and
+# with --pipeline, which lexes and writes the listing on threads of their
+# own: the speedup on large programs and the latency the threads add to tiny
+# ones. Both must write the same listing, apart from its date, and the same
+# object code.
+# usage: bench/pipeline.sh [runs] [size...]
+set -e
+
+runs=${1:-5}
+shift 2> /dev/null || true
+sizes=${*:-1K 100K 10M}
+work=${TMPDIR:-/tmp}/pascallite-pipeline.$$
+mkdir -p "$work"
+trap 'rm -rf "$work"' EXIT
+
+g++ -O2 -o "$work/stage02" stage02.cpp
+g++ -O2 -o "$work/compilebench" bench/compilebench.cpp
+
+# mean name command: print the mean wall time of runs runs of command
+mean()
+{
+	name=$1
+	shift
+	start=$(date +%s.%N)
+	i=0
+	while [ $i -lt "$runs" ]
+	do
+		sh -c "$*"
+		i=$((i + 1))
+	done
+	end=$(date +%s.%N)
+	printf '%-22s %10.3f ms\n' "$name" "$(echo "$start $end $runs" | awk '{ print ($2 - $1) * 1000 / $3 }')"
+}
+
+for size in $sizes
+do
+	"$work/compilebench" --generate="$work/program.pas" --size="$size" 2> /dev/null
+	mean "$size one thread" "$work/stage02 -O0 $work/program.pas $work/serial.lst $work/serial.obj"
+	mean "$size --pipeline" "$work/stage02 -O0 --pipeline $work/program.pas $work/pipeline.lst $work/pipeline.obj"
+
+	if ! cmp -s "$work/serial.obj" "$work/pipeline.obj" ||
+	   [ "$(tail -n +2 "$work/serial.lst" | cksum)" != "$(tail -n +2 "$work/pipeline.lst" | cksum)" ]
+	then
+		echo "$size: --pipeline output differs" >&2
+		exit 1
+	fi
+done
@@ -0,0 +1,61 @@
+#!/bin/sh
+# Measure the code the compiler generates for the kernels in bench/kernels:
+# static instructions, data words (DEC and BSS entries), spills (the STAs that
+# deassign the A register) and the instructions ramm executes with the
+# kernel's .in file as input. The run fails when a metric is above its limit
+# in bench/quality.thresholds; --update writes the current values there.
+# usage: bench/quality.sh [--update] [level...]
+set -e
+
+thresholds=bench/quality.thresholds
+update=no
+if [ "$1" = "--update" ]
+then
+	update=yes
+	shift
+fi
+levels=${*:-"-O0 -O1 -O2 -Os"}
+work=${TMPDIR:-/tmp}/pascallite-quality.$$
+mkdir -p "$work"
+trap 'rm -rf "$work"' EXIT
+
+g++ -O2 -o "$work/stage02" stage02.cpp
+g++ -O2 -o "$work/ramm" ramm.cpp
+
+printf '%-12s %-4s %8s %6s %7s %10s\n' KERNEL OPT STATIC DATA SPILLS DYNAMIC
+: > "$work/measured"
+for program in bench/kernels/*.pas
+do
+	kernel=$(basename "$program" .pas)
+	for level in $levels
+	do
+		"$work/stage02" "$level" "$program" "$work/$kernel.lst" "$work/$kernel.obj"
+		# A line without a label starts with a blank, so the opcode is $1
+		static=$(awk '{ opcode = /^ / ? $1 : $2 } opcode != "DEC" && opcode != "BSS" && opcode != "END" { n++ } END { print n + 0 }' "$work/$kernel.obj")
+		data=$(awk '{ opcode = /^ / ? $1 : $2 } opcode == "DEC" || opcode == "BSS" { n++ } END { print n + 0 }' "$work/$kernel.obj")
+		spills=$(grep -c 'STA .*deassign AReg' "$work/$kernel.obj" || true)
+		dynamic=$("$work/ramm" --stats "$work/$kernel.obj" < "bench/kernels/$kernel.in" 2>&1 >/dev/null |
+			awk '/instructions executed/ { print $3 }')
+		printf '%-12s %-4s %8s %6s %7s %10s\n' "$kernel" "$level" "$static" "$data" "$spills" "$dynamic"
+		printf '%s %s static %s\n%s %s data %s\n%s %s spills %s\n%s %s dynamic %s\n' \
+			"$kernel" "$level" "$static" "$kernel" "$level" "$data" \
+			"$kernel" "$level" "$spills" "$kernel" "$level" "$dynamic" >> "$work/measured"
+	done
+done
+
+if [ $update = yes ]
+then
+	{
+		echo "# kernel level metric limit, written by bench/quality.sh --update"
+		cat "$work/measured"
+	} > "$thresholds"
+	exit 0
+fi
+
+# Every measured metric with a limit must stay at or below it
+awk 'NR == FNR { if ($1 !~ /^#/ && NF == 4) limit[$1 " " $2 " " $3] = $4; next }
+	($1 " " $2 " " $3) in limit && $4 > limit[$1 " " $2 " " $3] {
+		printf "regression: %s %s %s is %s, limit %s\n", $1, $2, $3, $4, limit[$1 " " $2 " " $3]
+		failed = 1
+	}
+	END { exit failed }' "$thresholds" "$work/measured"
@@ -0,0 +1,1844 @@
+// Brian Leary
+//Joseph Lynch
+/*
+	This program is a RAMM assembler and simulator. It reads the object code
+	written by the Pascallite compiler, assembles it in a single pass into a
+	flat word-addressed memory, and executes it. RDI reads integers from the
+	standard input and PRI writes them to the standard output, one per line.
+	It also converts object code to and from a binary object format that is
+	loaded by mapping the file into memory.
+*/
+
+#include <iostream>
+#include <sstream>
+#include <fstream>
+#include <iomanip>
+#include <cstdlib>
+#include <cctype>
+#include <string>
+#include <vector>
+#include <map>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace std;
+
+// Operation codes. An instruction word holds the opcode in its upper 32 bits
+// and the operand address in its lower 32 bits.
+enum opcodes {LDA, STA, IAD, ISB, IMU, IDV, AZJ, AMJ, UNJ, STQ, RDI, PRI, NOP, HLT};
+const int NUMBER_OF_OPCODES = 14;
+const string OPCODE_NAMES[NUMBER_OF_OPCODES] =
+	{"LDA", "STA", "IAD", "ISB", "IMU", "IDV", "AZJ", "AMJ", "UNJ", "STQ", "RDI", "PRI", "NOP", "HLT"};
+
+// Define forward reference format. The word at address is patched with the
+// address of label plus offset once the label is defined.
+struct fixup
+{
+	unsigned int address;
+	string label;
+	long long offset;
+	unsigned int line;
+};
+
+// Define symbol format. Kind says whether the label names an instruction, a
+// DEC or a BSS; words is the size of its data and sourceName the remark of a
+// data definition, which holds the name of the variable or constant.
+struct symbol
+{
+	string name;
+	unsigned int address;
+	unsigned int kind;
+	unsigned int words;
+	string sourceName;
+};
+
+// Symbol kinds
+enum symbolKinds {SYMBOL_LABEL, SYMBOL_DEC, SYMBOL_BSS};
+
+// Define binary object format. The header is followed by the sections it
+// locates, each aligned to eight bytes: the instruction words, then the data
+// words, both already in the encoding of memory, the symbols, the line table
+// and the null-terminated names the symbols point to. Every field is little
+// endian, so a loader can map the file and use it without parsing.
+struct binaryHeader
+{
+	char magic[4];
+	uint32_t version;
+	uint32_t entry;
+	uint32_t codeWords;
+	uint32_t dataWords;
+	uint32_t symbolCount;
+	uint32_t lineCount;
+	uint32_t stringBytes;
+	uint64_t codeOffset;
+	uint64_t dataOffset;
+	uint64_t symbolOffset;
+	uint64_t lineOffset;
+	uint64_t stringOffset;
+};
+
+struct binarySymbol
+{
+	uint32_t address;
+	uint32_t kind;
+	uint32_t words;
+	uint32_t name;
+	uint32_t sourceName;
+};
+
+struct binaryLine
+{
+	uint32_t address;
+	uint32_t line;
+	uint32_t ordinal;
+	uint32_t hash;
+};
+
+const char BINARY_MAGIC[4] = {'R', 'A', 'M', 'B'};
+const uint32_t BINARY_VERSION = 1;
+
+// Define predecoded instruction format. Handler is the address of the code
+// executing the instruction; a, b and c are its operand addresses, resolved
+// and checked when the program is decoded. Superinstructions use b and c for
+// the operands of the instructions fused into them.
+struct decodedInstruction
+{
+	void *handler;
+	unsigned int a;
+	unsigned int b;
+	unsigned int c;
+};
+
+// Define the state shared by JIT-compiled code and its runtime stubs. The
+// compiled code keeps A, Q and the instruction count in host registers and
+// copies them here when it returns; pc and the returned status say why.
+struct jitContext
+{
+	long long a;
+	long long q;
+	unsigned long long count;
+	unsigned long long maxSteps;
+	unsigned long long pc;
+	long long *data;
+	istream *in;
+	ostream *out;
+};
+
+// Status returned by JIT-compiled code
+enum jitStatus {JIT_HALT, JIT_DIVISION_BY_ZERO, JIT_STEP_LIMIT, JIT_ILLEGAL, JIT_BAD_ADDRESS};
+
+// Flat word-addressed memory holding the assembled program and its data
+vector<long long> memory;
+
+// Labels defined so far and references to labels not defined yet, by label
+map<string, unsigned int> labelAddress;
+map<string, vector<fixup> > fixups;
+
+// Every label in the order it was defined, and the address of the first data
+// word, which ends the instructions
+vector<symbol> symbols;
+unsigned int dataStart = 0;
+bool dataStarted = false;
+
+// Address where execution starts, set by END
+unsigned int entryAddress = 0;
+
+// Registers and counters of the machine
+long long aRegister = 0;
+long long qRegister = 0;
+unsigned long long instructionCount = 0;
+unsigned long long maxSteps = 0;
+
+// Modeled cycles of each opcode, as in the compiler's cost model
+int opcodeCycles[NUMBER_OF_OPCODES] = 
+	{  2,     2,     2,     2,     4,     6,     2,     2,     2,     2,    10,    10,     1,     1};
+
+// Profile: the source line of each address, the order in which the compiler
+// emitted it for that line and the hash of the line, read from the compiler's
+// line table, and the number of times each address was executed and jumped
+bool profiling = false;
+vector<unsigned int> sourceLine, sourceOrdinal, sourceHash;
+vector<unsigned long long> executionCounts, takenCounts;
+bool hasLineTable = false;
+
+// Execution engine, switch, threaded or jit
+string engine = "threaded";
+
+// Machine code being generated by the JIT and the position of its epilogue
+vector<unsigned char> jitCode;
+unsigned int jitEpilogue = 0;
+
+// Function prototypes
+void Assemble(istream &objectStream);
+void AssembleLine(string line, unsigned int lineNo);
+void DefineLabel(string label, unsigned int lineNo);
+unsigned int ResolveOperand(string name, long long offset, unsigned int lineNo);
+int FindOpcode(string opcode);
+long long EncodeInstruction(int opcode, unsigned int address);
+bool IsBinaryObject(string fileName);
+bool SectionFits(uint64_t offset, uint64_t size, uint64_t fileSize);
+void LoadBinaryObject(string fileName);
+void WriteBinaryObject(string fileName);
+void WriteTextObject(string fileName);
+string OperandName(unsigned int address, const map<unsigned int, unsigned int> &firstLabelAt);
+void Run(istream &in, ostream &out);
+void RunSwitch(istream &in, ostream &out);
+void RunThreaded(istream &in, ostream &out);
+void RunJit(istream &in, ostream &out);
+void JitBytes(initializer_list<unsigned char> bytes);
+void JitWord32(unsigned int word);
+void JitWord64(unsigned long long word);
+void JitExit(unsigned int pc, int status);
+void JitPatch(unsigned int position, unsigned int target);
+void JitRead(jitContext *context, unsigned int address);
+void JitWrite(jitContext *context, unsigned int address);
+void Benchmark(string inputText, unsigned int runs);
+bool CrossCheck(string inputText);
+void LoadCostModel(string fileName);
+void LoadLineTable(string fileName);
+void WriteProfile(string sourceName, string annotateName, string foldedName, string programName);
+void WriteProfileRecords(string fileName);
+long long ReadInteger(istream &in);
+void CheckAddress(unsigned long long address, unsigned int pc);
+void AssemblyError(unsigned int lineNo, string errorMessage);
+void UndefinedLabelError();
+void RuntimeError(unsigned int pc, string errorMessage);
+
+int main(int argc, char **argv)
+{
+	// Usage: ramm [--input=text] [--max-steps=n] [--stats] [--engine=name] [--bench=n] [--cross-check]
+	//             [--cost-model=file] [--line-table=file] [--source=file] [--annotate=file]
+	//             [--folded=file] [--profile-out=file] [--write-binary=file]
+	//             [--write-text=file] object
+	ifstream objectStream;
+	istringstream inputBuffer;
+	string option, objectName = "", inputText, lineTableName = "", sourceName = "";
+	string annotateName = "", foldedName = "", profileOutName = "";
+	string writeBinaryName = "", writeTextName = "";
+	bool useInputBuffer = false, stats = false, crossCheck = false;
+	unsigned int benchRuns = 0;
+
+	for (int i = 1; i < argc; i += 1)
+	{
+		option = argv[i];
+
+		if (option.substr(0, 8) == "--input=")
+		{
+			inputText = option.substr(8);
+			useInputBuffer = true;
+		}
+		else if (option.substr(0, 12) == "--max-steps=")
+		{
+			maxSteps = strtoull(option.substr(12).c_str(), NULL, 10);
+		}
+		else if (option == "--stats")
+		{
+			stats = true;
+		}
+		else if (option.substr(0, 9) == "--engine=")
+		{
+			engine = option.substr(9);
+			if (engine != "switch" && engine != "threaded" && engine != "jit")
+			{
+				cerr << "unknown engine " << engine << "\n";
+				return 1;
+			}
+		}
+		else if (option.substr(0, 8) == "--bench=")
+		{
+			benchRuns = atoi(option.substr(8).c_str());
+		}
+		else if (option == "--cross-check")
+		{
+			crossCheck = true;
+		}
+		else if (option.substr(0, 13) == "--cost-model=")
+		{
+			LoadCostModel(option.substr(13));
+		}
+		else if (option.substr(0, 13) == "--line-table=")
+		{
+			lineTableName = option.substr(13);
+		}
+		else if (option.substr(0, 9) == "--source=")
+		{
+			sourceName = option.substr(9);
+		}
+		else if (option.substr(0, 11) == "--annotate=")
+		{
+			annotateName = option.substr(11);
+		}
+		else if (option.substr(0, 9) == "--folded=")
+		{
+			foldedName = option.substr(9);
+		}
+		else if (option.substr(0, 14) == "--profile-out=")
+		{
+			profileOutName = option.substr(14);
+		}
+		else if (option.substr(0, 15) == "--write-binary=")
+		{
+			writeBinaryName = option.substr(15);
+		}
+		else if (option.substr(0, 13) == "--write-text=")
+		{
+			writeTextName = option.substr(13);
+		}
+		else if (option[0] == '-' && option.length() > 1)
+		{
+			cerr << "unknown option " << option << "\n";
+			return 1;
+		}
+		else
+		{
+			objectName = option;
+		}
+	}
+
+	if (objectName == "")
+	{
+		cerr << "usage: " << argv[0] << " [--input=text] [--max-steps=n] [--stats] [--engine=name] [--bench=n]\n"
+		     << "       [--cross-check] [--cost-model=file] [--line-table=file] [--source=file]\n"
+		     << "       [--annotate=file] [--folded=file] [--profile-out=file] [--write-binary=file]\n"
+		     << "       [--write-text=file] object\n";
+		return 1;
+	}
+
+	objectStream.open(objectName.c_str());
+	if (!objectStream)
+	{
+		cerr << "cannot open " << objectName << "\n";
+		return 1;
+	}
+
+	ios::sync_with_stdio(false);
+
+	if (IsBinaryObject(objectName))
+		LoadBinaryObject(objectName);
+	else
+		Assemble(objectStream);
+
+	if (lineTableName != "")
+		LoadLineTable(lineTableName);
+
+	// Converting writes the other format instead of running the program
+	if (writeBinaryName != "" || writeTextName != "")
+	{
+		if (writeBinaryName != "")
+			WriteBinaryObject(writeBinaryName);
+		if (writeTextName != "")
+			WriteTextObject(writeTextName);
+		return 0;
+	}
+
+	if (profileOutName != "" && !hasLineTable)
+	{
+		cerr << "--profile-out needs --line-table\n";
+		return 1;
+	}
+
+	if (crossCheck)
+		return CrossCheck(inputText) ? 0 : 1;
+
+	// Profiling counts every address, which only the switch engine does. A
+	// binary object brings its own line table, used when a profile is asked for.
+	if (lineTableName != "" || 
+	    (hasLineTable && (sourceName != "" || annotateName != "" || foldedName != "" || profileOutName != "")))
+	{
+		profiling = true;
+		engine = "switch";
+		executionCounts.assign(memory.size(), 0);
+		takenCounts.assign(memory.size(), 0);
+	}
+
+	if (benchRuns > 0)
+	{
+		Benchmark(inputText, benchRuns);
+		return 0;
+	}
+
+	// Output goes through the buffer of cout, which is flushed whenever it
+	// fills and before a runtime error is reported
+	if (useInputBuffer)
+	{
+		inputBuffer.str(inputText);
+		Run(inputBuffer, cout);
+	}
+	else
+	{
+		Run(cin, cout);
+	}
+	cout.flush();
+
+	if (profiling)
+		WriteProfile(sourceName, annotateName, foldedName, objectName);
+	if (profileOutName != "")
+		WriteProfileRecords(profileOutName);
+
+	if (stats)
+	{
+		cerr << "instructions executed: " << instructionCount << "\n";
+		cerr << "memory words:          " << memory.size() << "\n";
+	}
+
+	return 0;
+}
+
+// Assemble object code in a single pass. References to labels that are not
+// defined yet are patched as soon as the label appears.
+void Assemble(istream &objectStream)
+{
+	string line;
+	unsigned int lineNo = 0;
+
+	while (getline(objectStream, line))
+	{
+		lineNo += 1;
+		AssembleLine(line, lineNo);
+	}
+
+	if (!fixups.empty())
+	{
+		UndefinedLabelError();
+	}
+}
+
+// Assemble one line. The label starts in the first column, the opcode
+// follows it, and the operand field is the nine columns after the opcode.
+// Inside the operand field a name may be followed by an offset, as in L3  +1.
+void AssembleLine(string line, unsigned int lineNo)
+{
+	string label = "", opcode, name = "", offsetText = "";
+	unsigned int position = 0, fieldEnd, nameEnd;
+	long long offset = 0;
+	int opcodeIndex;
+
+	if (!line.empty() && line[line.length() - 1] == '\r')
+		line.erase(line.length() - 1);
+
+	while (position < line.length() && line[position] != ' ')
+	{
+		label += line[position];
+		position += 1;
+	}
+	while (position < line.length() && line[position] == ' ')
+	{
+		position += 1;
+	}
+
+	if (position >= line.length())
+	{
+		if (label != "")
+			AssemblyError(lineNo, "opcode expected after label " + label);
+		return;
+	}
+
+	opcode = line.substr(position, 3);
+	position += 4;
+	fieldEnd = position + 9;
+
+	while (position < line.length() && line[position] != ' ' &&
+	       (name == "" || (line[position] != '+' && line[position] != '-')))
+	{
+		name += line[position];
+		position += 1;
+	}
+	nameEnd = position;
+	while (position < line.length() && position < fieldEnd && line[position] == ' ')
+	{
+		position += 1;
+	}
+
+	// The remark starts after the operand field and may begin with a sign
+	if (position < line.length() && (position < fieldEnd || position == nameEnd) &&
+	    (line[position] == '+' || line[position] == '-'))
+	{
+		offsetText = line[position];
+		position += 1;
+		while (position < line.length() && isdigit(line[position]))
+		{
+			offsetText += line[position];
+			position += 1;
+		}
+		offset = atoll(offsetText.c_str());
+	}
+
+	while (position < line.length() && line[position] == ' ')
+	{
+		position += 1;
+	}
+
+	if ((opcode == "DEC" || opcode == "BSS") && !dataStarted)
+	{
+		dataStart = memory.size();
+		dataStarted = true;
+	}
+
+	if (opcode == "END")
+	{
+		if (label != "")
+			DefineLabel(label, lineNo);
+		entryAddress = ResolveOperand(name, offset, lineNo);
+		if (!fixups.empty())
+			UndefinedLabelError();
+		return;
+	}
+
+	if (label != "")
+	{
+		DefineLabel(label, lineNo);
+		if (opcode == "DEC" || opcode == "BSS")
+		{
+			symbols.back().kind = opcode == "DEC" ? SYMBOL_DEC : SYMBOL_BSS;
+			symbols.back().words = opcode == "DEC" ? 1 : atoll(name.c_str());
+			symbols.back().sourceName = line.substr(position);
+		}
+	}
+
+	if (opcode == "DEC")
+	{
+		if (name == "" || (!isdigit(name[name.length() - 1])))
+			AssemblyError(lineNo, "integer expected after DEC");
+		memory.push_back(atoll(name.c_str()));
+	}
+	else if (opcode == "BSS")
+	{
+		if (name == "" || atoll(name.c_str()) < 0)
+			AssemblyError(lineNo, "word count expected after BSS");
+		memory.resize(memory.size() + atoll(name.c_str()), 0);
+	}
+	else
+	{
+		opcodeIndex = FindOpcode(opcode);
+		if (opcodeIndex == -1)
+			AssemblyError(lineNo, "unknown opcode " + opcode);
+
+		if (name == "")
+		{
+			if (opcodeIndex != NOP && opcodeIndex != HLT)
+				AssemblyError(lineNo, "operand expected after " + opcode);
+			memory.push_back(EncodeInstruction(opcodeIndex, 0));
+		}
+		else
+		{
+			memory.push_back(0);
+			memory.back() = EncodeInstruction(opcodeIndex, ResolveOperand(name, offset, lineNo));
+		}
+	}
+}
+
+// Define a label at the next free word and patch the references waiting for it
+void DefineLabel(string label, unsigned int lineNo)
+{
+	unsigned int address = memory.size();
+
+	if (labelAddress.find(label) != labelAddress.end())
+		AssemblyError(lineNo, "multiple definition of label " + label);
+
+	labelAddress[label] = address;
+
+	symbol newSymbol;
+	newSymbol.name = label;
+	newSymbol.address = address;
+	newSymbol.kind = SYMBOL_LABEL;
+	newSymbol.words = 0;
+	newSymbol.sourceName = "";
+	symbols.push_back(newSymbol);
+
+	if (fixups.find(label) != fixups.end())
+	{
+		vector<fixup> &waiting = fixups[label];
+		for (unsigned int i = 0; i < waiting.size(); i += 1)
+		{
+			memory[waiting[i].address] += (address + waiting[i].offset) & 0xffffffffLL;
+		}
+		fixups.erase(label);
+	}
+}
+
+// Returns the address of name plus offset. A name that is not defined yet is
+// recorded as a fixup of the word about to be assembled, and 0 is returned.
+unsigned int ResolveOperand(string name, long long offset, unsigned int lineNo)
+{
+	fixup newFixup;
+
+	if (labelAddress.find(name) != labelAddress.end())
+	{
+		return labelAddress[name] + offset;
+	}
+
+	newFixup.address = memory.size() - 1;
+	newFixup.label = name;
+	newFixup.offset = offset;
+	newFixup.line = lineNo;
+	fixups[name].push_back(newFixup);
+
+	return 0;
+}
+
+int FindOpcode(string opcode)
+{
+	for (int i = 0; i < NUMBER_OF_OPCODES; i += 1)
+	{
+		if (OPCODE_NAMES[i] == opcode)
+			return i;
+	}
+
+	return -1;
+}
+
+long long EncodeInstruction(int opcode, unsigned int address)
+{
+	return ((long long) opcode << 32) | address;
+}
+
+// Returns true if the file starts with the magic of the binary object format
+bool IsBinaryObject(string fileName)
+{
+	ifstream objectFile(fileName.c_str(), ios::binary);
+	char magic[4];
+
+	return objectFile.read(magic, 4) && memcmp(magic, BINARY_MAGIC, 4) == 0;
+}
+
+// Returns true if a section of size bytes at offset lies within a file of
+// fileSize bytes. No sum is formed, so a huge offset cannot wrap around.
+bool SectionFits(uint64_t offset, uint64_t size, uint64_t fileSize)
+{
+	return offset <= fileSize && size <= fileSize - offset;
+}
+
+// Map a binary object into memory and load it. The header is checked and
+// every section is copied as it is; nothing is parsed.
+void LoadBinaryObject(string fileName)
+{
+	struct stat status;
+	const binaryHeader *header;
+	const binarySymbol *binarySymbols;
+	const binaryLine *lines;
+	const char *strings, *base;
+	const long long *words;
+	symbol newSymbol;
+	int descriptor;
+	void *mapped;
+
+	descriptor = open(fileName.c_str(), O_RDONLY);
+	if (descriptor == -1 || fstat(descriptor, &status) == -1 || status.st_size < (off_t) sizeof(binaryHeader))
+		AssemblyError(0, "cannot read binary object " + fileName);
+
+	mapped = mmap(NULL, status.st_size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+	close(descriptor);
+	if (mapped == MAP_FAILED)
+		AssemblyError(0, "cannot map binary object " + fileName);
+
+	base = (const char *) mapped;
+	header = (const binaryHeader *) base;
+	if (memcmp(header->magic, BINARY_MAGIC, 4) != 0)
+		AssemblyError(0, "not a binary object " + fileName);
+	if (header->version != BINARY_VERSION)
+		AssemblyError(0, "unsupported binary object version");
+	if (!SectionFits(header->codeOffset, 8ULL * header->codeWords, status.st_size) ||
+	    !SectionFits(header->dataOffset, 8ULL * header->dataWords, status.st_size) ||
+	    !SectionFits(header->symbolOffset, sizeof(binarySymbol) * (uint64_t) header->symbolCount, status.st_size) ||
+	    !SectionFits(header->lineOffset, sizeof(binaryLine) * (uint64_t) header->lineCount, status.st_size) ||
+	    !SectionFits(header->stringOffset, header->stringBytes, status.st_size) ||
+	    header->stringBytes == 0 || base[header->stringOffset + header->stringBytes - 1] != '\0')
+		AssemblyError(0, "truncated binary object " + fileName);
+	if (header->entry >= (uint64_t) header->codeWords + header->dataWords)
+		AssemblyError(0, "entry point outside the binary object " + fileName);
+
+	words = (const long long *) (base + header->codeOffset);
+	memory.assign(words, words + header->codeWords);
+	words = (const long long *) (base + header->dataOffset);
+	memory.insert(memory.end(), words, words + header->dataWords);
+	dataStart = header->codeWords;
+	dataStarted = header->dataWords > 0;
+	entryAddress = header->entry;
+
+	binarySymbols = (const binarySymbol *) (base + header->symbolOffset);
+	strings = base + header->stringOffset;
+	for (unsigned int i = 0; i < header->symbolCount; i += 1)
+	{
+		if (binarySymbols[i].name >= header->stringBytes || binarySymbols[i].sourceName >= header->stringBytes)
+			AssemblyError(0, "bad symbol in binary object " + fileName);
+		newSymbol.name = strings + binarySymbols[i].name;
+		newSymbol.address = binarySymbols[i].address;
+		newSymbol.kind = binarySymbols[i].kind;
+		newSymbol.words = binarySymbols[i].words;
+		newSymbol.sourceName = strings + binarySymbols[i].sourceName;
+		symbols.push_back(newSymbol);
+		labelAddress[newSymbol.name] = newSymbol.address;
+	}
+
+	lines = (const binaryLine *) (base + header->lineOffset);
+	if (header->lineCount > 0)
+	{
+		sourceLine.assign(memory.size(), 0);
+		sourceOrdinal.assign(memory.size(), 0xffffffff);
+		sourceHash.assign(memory.size(), 0);
+		hasLineTable = true;
+	}
+	for (unsigned int i = 0; i < header->lineCount; i += 1)
+	{
+		if (lines[i].address < memory.size())
+		{
+			sourceLine[lines[i].address] = lines[i].line;
+			sourceOrdinal[lines[i].address] = lines[i].ordinal;
+			sourceHash[lines[i].address] = lines[i].hash;
+		}
+	}
+
+	munmap(mapped, status.st_size);
+}
+
+// Write the assembled program as a binary object, with the line table if
+// one was read
+void WriteBinaryObject(string fileName)
+{
+	ofstream objectFile(fileName.c_str(), ios::binary);
+	binaryHeader header;
+	vector<binarySymbol> binarySymbols;
+	vector<binaryLine> lines;
+	string strings(1, '\0');
+	binarySymbol newSymbol;
+	binaryLine newLine;
+	uint64_t offset;
+	const char padding[8] = {0};
+
+	if (!dataStarted)
+		dataStart = memory.size();
+
+	for (unsigned int i = 0; i < symbols.size(); i += 1)
+	{
+		newSymbol.address = symbols[i].address;
+		newSymbol.kind = symbols[i].kind;
+		newSymbol.words = symbols[i].words;
+		newSymbol.name = strings.size();
+		strings += symbols[i].name + '\0';
+		newSymbol.sourceName = 0;
+		if (symbols[i].sourceName != "")
+		{
+			newSymbol.sourceName = strings.size();
+			strings += symbols[i].sourceName + '\0';
+		}
+		binarySymbols.push_back(newSymbol);
+	}
+
+	for (unsigned int i = 0; i < sourceLine.size(); i += 1)
+	{
+		if (sourceLine[i] != 0)
+		{
+			newLine.address = i;
+			newLine.line = sourceLine[i];
+			newLine.ordinal = sourceOrdinal[i];
+			newLine.hash = sourceHash[i];
+			lines.push_back(newLine);
+		}
+	}
+
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, BINARY_MAGIC, 4);
+	header.version = BINARY_VERSION;
+	header.entry = entryAddress;
+	header.codeWords = dataStart;
+	header.dataWords = memory.size() - dataStart;
+	header.symbolCount = binarySymbols.size();
+	header.lineCount = lines.size();
+	header.stringBytes = strings.size();
+
+	offset = (sizeof(header) + 7) & ~7ULL;
+	header.codeOffset = offset;
+	offset += 8ULL * header.codeWords;
+	header.dataOffset = offset;
+	offset += 8ULL * header.dataWords;
+	header.symbolOffset = offset;
+	offset += (sizeof(binarySymbol) * binarySymbols.size() + 7) & ~7ULL;
+	header.lineOffset = offset;
+	offset += sizeof(binaryLine) * lines.size();
+	header.stringOffset = offset;
+
+	objectFile.write((const char *) &header, sizeof(header));
+	objectFile.write(padding, header.codeOffset - sizeof(header));
+	objectFile.write((const char *) memory.data(), 8ULL * memory.size());
+	objectFile.write((const char *) binarySymbols.data(), sizeof(binarySymbol) * binarySymbols.size());
+	objectFile.write(padding, header.lineOffset - header.symbolOffset - sizeof(binarySymbol) * binarySymbols.size());
+	objectFile.write((const char *) lines.data(), sizeof(binaryLine) * lines.size());
+	objectFile.write(strings.data(), strings.size());
+}
+
+// Write the program as text object code. Instructions name their operands by
+// label, data is written as DEC and BSS again, and a label sharing its address
+// with another one is defined by an empty BSS in front of it. The label and
+// operand fields are widened, as the compiler does, when a name or value does
+// not fit the usual six and nine columns.
+void WriteTextObject(string fileName)
+{
+	ofstream objectFile(fileName.c_str());
+	map<unsigned int, vector<unsigned int> > labelsAt;
+	map<unsigned int, unsigned int> firstLabelAt;
+	vector<unsigned int> *labels;
+	vector<string> operands;
+	unsigned int address = 0, words, opcode, labelWidth = 6, operandWidth = 9;
+	int last;
+	string label, operand, remark;
+	ostringstream value;
+
+	for (unsigned int i = 0; i < symbols.size(); i += 1)
+	{
+		labelsAt[symbols[i].address].push_back(i);
+		firstLabelAt.insert(make_pair(symbols[i].address, i));
+		if (symbols[i].name.length() + 1 > labelWidth)
+			labelWidth = symbols[i].name.length() + 1;
+	}
+
+	// Name the operand of every instruction and find the widest operand field
+	operands.resize(dataStart);
+	for (unsigned int i = 0; i < memory.size(); i += 1)
+	{
+		if (i < dataStart)
+		{
+			opcode = (unsigned int) ((unsigned long long) memory[i] >> 32);
+			if (opcode >= NUMBER_OF_OPCODES)
+				AssemblyError(0, "illegal instruction at address " + to_string(i));
+			if (opcode != NOP && opcode != HLT)
+				operands[i] = OperandName((unsigned int) (memory[i] & 0xffffffffLL), firstLabelAt);
+			operand = operands[i];
+		}
+		else
+		{
+			operand = to_string(memory[i]);
+		}
+		if (operand.length() + 1 > operandWidth)
+			operandWidth = operand.length() + 1;
+	}
+
+	while (address <= memory.size())
+	{
+		// Every label but the one written with the word gets an empty BSS
+		labels = &labelsAt[address];
+		last = -1;
+		if (!labels->empty() && address < memory.size() && 
+		    (symbols[labels->back()].kind != SYMBOL_BSS || symbols[labels->back()].words > 0))
+			last = labels->back();
+		for (unsigned int i = 0; i < labels->size(); i += 1)
+		{
+			if ((int) (*labels)[i] != last)
+				objectFile << setw(labelWidth) << left << symbols[(*labels)[i]].name << "BSS " 
+				           << setw(operandWidth) << left << "0000" << symbols[(*labels)[i]].sourceName << "\n";
+		}
+		if (address == memory.size())
+			break;
+		
+		label = last == -1 ? "" : symbols[last].name;
+		remark = last == -1 ? "" : symbols[last].sourceName;
+		words = 1;
+
+		if (address < dataStart)
+		{
+			opcode = (unsigned int) ((unsigned long long) memory[address] >> 32);
+			objectFile << setw(labelWidth) << left << label << OPCODE_NAMES[opcode] << " " 
+			           << setw(operandWidth) << left << operands[address] << "\n";
+		}
+		else if (last != -1 && symbols[last].kind == SYMBOL_BSS)
+		{
+			words = symbols[last].words;
+			if (labelsAt.upper_bound(address) != labelsAt.end() && 
+			    labelsAt.upper_bound(address)->first < address + words)
+				words = labelsAt.upper_bound(address)->first - address;
+			value.str("");
+			value << setw(4) << setfill('0') << right << words;
+			objectFile << setw(labelWidth) << left << label << "BSS " << setw(operandWidth) << left << value.str() 
+			           << remark << "\n";
+		}
+		else
+		{
+			value.str("");
+			if (memory[address] < 0)
+				value << "-" << setw(3) << setfill('0') << right << (0 - (unsigned long long) memory[address]);
+			else
+				value << setw(4) << setfill('0') << right << memory[address];
+			objectFile << setw(labelWidth) << left << label << "DEC " << setw(operandWidth) << left << value.str() 
+			           << remark << "\n";
+		}
+
+		address += words;
+	}
+
+	objectFile << setw(labelWidth) << left << "" << "END " << OperandName(entryAddress, firstLabelAt) << "\n";
+}
+
+// Returns the operand naming an address: the label defined there, or the
+// nearest label before it and the distance, as in L3  +1. firstLabelAt holds
+// the first label defined at each address.
+string OperandName(unsigned int address, const map<unsigned int, unsigned int> &firstLabelAt)
+{
+	map<unsigned int, unsigned int>::const_iterator nearest = firstLabelAt.upper_bound(address);
+	string name;
+
+	if (nearest == firstLabelAt.begin())
+		AssemblyError(0, "no label before address " + to_string(address));
+	nearest--;
+	name = symbols[nearest->second].name;
+	if (nearest->first == address)
+		return name;
+
+	while (name.length() < 4)
+		name += " ";
+	return name + "+" + to_string(address - nearest->first);
+}
+
+// Execute the program with the selected engine
+void Run(istream &in, ostream &out)
+{
+	if (engine == "switch")
+		RunSwitch(in, out);
+	else if (engine == "jit")
+		RunJit(in, out);
+	else
+		RunThreaded(in, out);
+}
+
+// Execute the program from the entry address until HLT, decoding each word
+// as it is fetched
+void RunSwitch(istream &in, ostream &out)
+{
+	unsigned int pc = entryAddress, address;
+	long long word, divisor;
+
+	while (true)
+	{
+		CheckAddress(pc, pc);
+		word = memory[pc];
+		address = (unsigned int) (word & 0xffffffffLL);
+
+		instructionCount += 1;
+		if (maxSteps != 0 && instructionCount > maxSteps)
+			RuntimeError(pc, "step limit exceeded");
+		if (profiling)
+			executionCounts[pc] += 1;
+
+		switch (word >> 32)
+		{
+			case LDA:
+				CheckAddress(address, pc);
+				aRegister = memory[address];
+				pc += 1;
+				break;
+			case STA:
+				CheckAddress(address, pc);
+				memory[address] = aRegister;
+				pc += 1;
+				break;
+			case IAD:
+				CheckAddress(address, pc);
+				aRegister = (long long) ((unsigned long long) aRegister + (unsigned long long) memory[address]);
+				pc += 1;
+				break;
+			case ISB:
+				CheckAddress(address, pc);
+				aRegister = (long long) ((unsigned long long) aRegister - (unsigned long long) memory[address]);
+				pc += 1;
+				break;
+			case IMU:
+				CheckAddress(address, pc);
+				aRegister = (long long) ((unsigned long long) aRegister * (unsigned long long) memory[address]);
+				pc += 1;
+				break;
+			case IDV:
+				CheckAddress(address, pc);
+				divisor = memory[address];
+				if (divisor == 0)
+					RuntimeError(pc, "division by zero");
+				if (divisor == -1)
+				{
+					aRegister = (long long) (0 - (unsigned long long) aRegister);
+					qRegister = 0;
+				}
+				else
+				{
+					qRegister = aRegister % divisor;
+					aRegister = aRegister / divisor;
+				}
+				pc += 1;
+				break;
+			case AZJ:
+				if (profiling && aRegister == 0)
+					takenCounts[pc] += 1;
+				pc = (aRegister == 0) ? address : pc + 1;
+				break;
+			case AMJ:
+				if (profiling && aRegister < 0)
+					takenCounts[pc] += 1;
+				pc = (aRegister < 0) ? address : pc + 1;
+				break;
+			case UNJ:
+				if (profiling)
+					takenCounts[pc] += 1;
+				pc = address;
+				break;
+			case STQ:
+				CheckAddress(address, pc);
+				memory[address] = qRegister;
+				pc += 1;
+				break;
+			case RDI:
+				CheckAddress(address, pc);
+				memory[address] = ReadInteger(in);
+				pc += 1;
+				break;
+			case PRI:
+				CheckAddress(address, pc);
+				out << memory[address] << '\n';
+				pc += 1;
+				break;
+			case NOP:
+				pc += 1;
+				break;
+			case HLT:
+				return;
+			default:
+				RuntimeError(pc, "illegal instruction");
+		}
+	}
+}
+
+// Execute the program with direct-threaded dispatch. The program is first
+// decoded into one entry per memory word whose handler is the address of the
+// label executing it, so each instruction jumps straight to the next one's
+// code. Operand addresses are checked while decoding, and the frequent
+// sequences LDA IAD, LDA ISB, STA LDA and LDA ISB AZJ/AMJ become single
+// superinstructions. The entries after the first word of a superinstruction
+// are decoded as well, so a jump into the middle of one still works. The
+// step limit is checked on taken jumps, since every endless loop takes one.
+// Compiled programs never store into their code, which is decoded only once.
+void RunThreaded(istream &in, ostream &out)
+{
+	vector<decodedInstruction> code(memory.size() + 1);
+	decodedInstruction *ip;
+	long long *data = &memory[0];
+	long long word, divisor;
+	unsigned int size = memory.size(), opcode, address;
+
+	static void *handlers[NUMBER_OF_OPCODES] =
+		{&&lda, &&sta, &&iad, &&isb, &&imu, &&idv, &&azj, &&amj, &&unj, &&stq, &&rdi, &&pri, &&nop, &&hlt};
+
+	#define NEXT goto *ip->handler
+	#define CHECK_STEPS if (maxSteps != 0 && instructionCount > maxSteps) RuntimeError(ip - &code[0], "step limit exceeded")
+
+	for (unsigned int i = 0; i < size; i += 1)
+	{
+		word = memory[i];
+		opcode = (unsigned int) ((unsigned long long) word >> 32);
+		address = (unsigned int) (word & 0xffffffffLL);
+
+		code[i].a = address;
+		code[i].b = 0;
+		code[i].c = 0;
+
+		if (word < 0 || opcode >= (unsigned int) NUMBER_OF_OPCODES)
+			code[i].handler = &&illegal;
+		else if (opcode == NOP || opcode == HLT)
+			code[i].handler = handlers[opcode];
+		else if ((opcode == AZJ || opcode == AMJ || opcode == UNJ) ? address > size : address >= size)
+			code[i].handler = &&badAddress;
+		else
+			code[i].handler = handlers[opcode];
+	}
+	code[size].handler = &&badAddress;
+
+	for (unsigned int i = 0; i + 1 < size; i += 1)
+	{
+		if (code[i].handler == &&lda && code[i + 1].handler == &&isb && i + 2 < size &&
+		    (code[i + 2].handler == &&azj || code[i + 2].handler == &&amj))
+		{
+			code[i].handler = (code[i + 2].handler == &&azj) ? &&ldaIsbAzj : &&ldaIsbAmj;
+			code[i].b = code[i + 1].a;
+			code[i].c = code[i + 2].a;
+		}
+		else if (code[i].handler == &&lda && code[i + 1].handler == &&iad)
+		{
+			code[i].handler = &&ldaIad;
+			code[i].b = code[i + 1].a;
+		}
+		else if (code[i].handler == &&lda && code[i + 1].handler == &&isb)
+		{
+			code[i].handler = &&ldaIsb;
+			code[i].b = code[i + 1].a;
+		}
+		else if (code[i].handler == &&sta && code[i + 1].handler == &&lda)
+		{
+			code[i].handler = &&staLda;
+			code[i].b = code[i + 1].a;
+		}
+	}
+
+	ip = &code[entryAddress];
+	if (entryAddress > size)
+		ip = &code[size];
+	NEXT;
+
+lda:
+	aRegister = data[ip->a];
+	instructionCount += 1;
+	ip += 1;
+	NEXT;
+sta:
+	data[ip->a] = aRegister;
+	instructionCount += 1;
+	ip += 1;
+	NEXT;
+iad:
+	aRegister = (long long) ((unsigned long long) aRegister + (unsigned long long) data[ip->a]);
+	instructionCount += 1;
+	ip += 1;
+	NEXT;
+isb:
+	aRegister = (long long) ((unsigned long long) aRegister - (unsigned long long) data[ip->a]);
+	instructionCount += 1;
+	ip += 1;
+	NEXT;
+imu:
+	aRegister = (long long) ((unsigned long long) aRegister * (unsigned long long) data[ip->a]);
+	instructionCount += 1;
+	ip += 1;
+	NEXT;
+idv:
+	instructionCount += 1;
+	divisor = data[ip->a];
+	if (divisor == 0)
+		RuntimeError(ip - &code[0], "division by zero");
+	if (divisor == -1)
+	{
+		aRegister = (long long) (0 - (unsigned long long) aRegister);
+		qRegister = 0;
+	}
+	else
+	{
+		qRegister = aRegister % divisor;
+		aRegister = aRegister / divisor;
+	}
+	ip += 1;
+	NEXT;
+azj:
+	instructionCount += 1;
+	if (aRegister == 0)
+	{
+		ip = &code[ip->a];
+		CHECK_STEPS;
+	}
+	else
+		ip += 1;
+	NEXT;
+amj:
+	instructionCount += 1;
+	if (aRegister < 0)
+	{
+		ip = &code[ip->a];
+		CHECK_STEPS;
+	}
+	else
+		ip += 1;
+	NEXT;
+unj:
+	instructionCount += 1;
+	ip = &code[ip->a];
+	CHECK_STEPS;
+	NEXT;
+stq:
+	data[ip->a] = qRegister;
+	instructionCount += 1;
+	ip += 1;
+	NEXT;
+rdi:
+	data[ip->a] = ReadInteger(in);
+	instructionCount += 1;
+	ip += 1;
+	NEXT;
+pri:
+	out << data[ip->a] << '\n';
+	instructionCount += 1;
+	ip += 1;
+	NEXT;
+nop:
+	instructionCount += 1;
+	ip += 1;
+	NEXT;
+hlt:
+	instructionCount += 1;
+	return;
+ldaIad:
+	aRegister = (long long) ((unsigned long long) data[ip->a] + (unsigned long long) data[ip->b]);
+	instructionCount += 2;
+	ip += 2;
+	NEXT;
+ldaIsb:
+	aRegister = (long long) ((unsigned long long) data[ip->a] - (unsigned long long) data[ip->b]);
+	instructionCount += 2;
+	ip += 2;
+	NEXT;
+staLda:
+	data[ip->a] = aRegister;
+	aRegister = data[ip->b];
+	instructionCount += 2;
+	ip += 2;
+	NEXT;
+ldaIsbAzj:
+	aRegister = (long long) ((unsigned long long) data[ip->a] - (unsigned long long) data[ip->b]);
+	instructionCount += 3;
+	if (aRegister == 0)
+	{
+		ip = &code[ip->c];
+		CHECK_STEPS;
+	}
+	else
+		ip += 3;
+	NEXT;
+ldaIsbAmj:
+	aRegister = (long long) ((unsigned long long) data[ip->a] - (unsigned long long) data[ip->b]);
+	instructionCount += 3;
+	if (aRegister < 0)
+	{
+		ip = &code[ip->c];
+		CHECK_STEPS;
+	}
+	else
+		ip += 3;
+	NEXT;
+illegal:
+	RuntimeError(ip - &code[0], "illegal instruction");
+badAddress:
+	RuntimeError(ip - &code[0], "address out of range");
+
+	#undef NEXT
+	#undef CHECK_STEPS
+}
+
+// Run the program runs times with each engine on the same input and print
+// the instructions executed per second. Memory is restored before each run.
+void Benchmark(string inputText, unsigned int runs)
+{
+	const string ENGINES[3] = {"switch", "threaded", "jit"};
+	vector<long long> initialMemory = memory;
+	unsigned long long executed;
+	double seconds;
+
+	cout << "ENGINE        RUNS  INSTRUCTIONS   SECONDS  INSTRUCTIONS/SEC\n";
+
+	for (int e = 0; e < 3; e += 1)
+	{
+		engine = ENGINES[e];
+		executed = 0;
+
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+		for (unsigned int i = 0; i < runs; i += 1)
+		{
+			istringstream in(inputText);
+			ostringstream out;
+
+			memory = initialMemory;
+			aRegister = 0;
+			qRegister = 0;
+			instructionCount = 0;
+			Run(in, out);
+			executed += instructionCount;
+		}
+		seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+		cout << left << setw(10) << engine << right << setw(8) << runs << setw(14) << executed
+		     << setw(10) << fixed << setprecision(3) << seconds
+		     << setw(18) << setprecision(0) << (seconds > 0 ? executed / seconds : 0) << "\n";
+	}
+}
+
+// Run the program with each engine on the same input and compare the output,
+// the instructions executed and the final memory with those of the switch
+// engine, which is the reference. Returns true when all engines agree.
+bool CrossCheck(string inputText)
+{
+	const string ENGINES[3] = {"switch", "threaded", "jit"};
+	vector<long long> initialMemory = memory, referenceMemory;
+	unsigned long long referenceCount = 0;
+	string referenceOutput;
+	bool agree = true;
+
+	for (int e = 0; e < 3; e += 1)
+	{
+		istringstream in(inputText);
+		ostringstream out;
+
+		engine = ENGINES[e];
+		memory = initialMemory;
+		aRegister = 0;
+		qRegister = 0;
+		instructionCount = 0;
+		Run(in, out);
+
+		if (e == 0)
+		{
+			referenceOutput = out.str();
+			referenceCount = instructionCount;
+			referenceMemory = memory;
+		}
+		else
+		{
+			if (out.str() != referenceOutput)
+			{
+				cerr << engine << ": output differs from switch\n";
+				agree = false;
+			}
+			if (instructionCount != referenceCount)
+			{
+				cerr << engine << ": executed " << instructionCount << " instructions, switch executed "
+				     << referenceCount << "\n";
+				agree = false;
+			}
+			if (memory != referenceMemory)
+			{
+				cerr << engine << ": final memory differs from switch\n";
+				agree = false;
+			}
+		}
+	}
+
+	if (agree)
+		cout << "engines agree: " << referenceCount << " instructions\n";
+
+	return agree;
+}
+
+// Execute the program as x86-64 machine code. Each basic block is translated
+// into native code in an mmap'd buffer: A lives in r12, Q in r13 and the
+// instruction count in r14, which is advanced by the length of a block when
+// the block is entered. rbx holds the memory base and rbp the jitContext.
+// AZJ, AMJ and UNJ become native branches, and RDI and PRI call JitRead and
+// JitWrite. Errors store the failing address and return a jitStatus. Words
+// that are not instructions, and instructions whose operand is out of range,
+// are translated into an error exit, as in the threaded engine.
+void RunJit(istream &in, ostream &out)
+{
+	unsigned int size = memory.size(), opcode, address, length;
+	vector<unsigned int> native(size + 1), jumpPositions, jumpTargets;
+	vector<bool> leader(size + 1, false);
+	jitContext context;
+	long long word;
+	unsigned char *buffer;
+	int status;
+
+	// Other hosts, and programs too large for the 32 bit displacement of a
+	// memory operand, use the threaded engine
+#ifndef __x86_64__
+	size = 0x10000000;
+#endif
+	if (size >= 0x10000000)
+	{
+		RunThreaded(in, out);
+		return;
+	}
+
+	// Find the first instruction of each basic block
+	leader[entryAddress < size ? entryAddress : size] = true;
+	for (unsigned int i = 0; i < size; i += 1)
+	{
+		word = memory[i];
+		opcode = (unsigned int) ((unsigned long long) word >> 32);
+		address = (unsigned int) (word & 0xffffffffLL);
+
+		if (word < 0 || opcode >= (unsigned int) NUMBER_OF_OPCODES)
+		{
+			leader[i] = true;
+			leader[i + 1] = true;
+		}
+		else if (opcode == AZJ || opcode == AMJ || opcode == UNJ || opcode == HLT)
+		{
+			if ((opcode == AZJ || opcode == AMJ || opcode == UNJ) && address <= size)
+				leader[address] = true;
+			leader[i + 1] = true;
+		}
+	}
+
+	jitCode.clear();
+
+	// Prologue: save registers, load the machine state and jump to the entry
+	JitBytes({0x53, 0x55, 0x41, 0x54, 0x41, 0x55, 0x41, 0x56, 0x41, 0x57});
+	JitBytes({0x48, 0x83, 0xEC, 0x08});
+	JitBytes({0x48, 0x89, 0xFB, 0x48, 0x89, 0xF5});
+	JitBytes({0x4C, 0x8B, 0x65, (unsigned char) offsetof(jitContext, a)});
+	JitBytes({0x4C, 0x8B, 0x6D, (unsigned char) offsetof(jitContext, q)});
+	JitBytes({0x4C, 0x8B, 0x75, (unsigned char) offsetof(jitContext, count)});
+	JitBytes({0x4C, 0x8B, 0x7D, (unsigned char) offsetof(jitContext, maxSteps)});
+	JitBytes({0xE9});
+	jumpPositions.push_back(jitCode.size());
+	jumpTargets.push_back(entryAddress < size ? entryAddress : size);
+	JitWord32(0);
+
+	// Epilogue: store the machine state, restore registers and return eax
+	jitEpilogue = jitCode.size();
+	JitBytes({0x4C, 0x89, 0x65, (unsigned char) offsetof(jitContext, a)});
+	JitBytes({0x4C, 0x89, 0x6D, (unsigned char) offsetof(jitContext, q)});
+	JitBytes({0x4C, 0x89, 0x75, (unsigned char) offsetof(jitContext, count)});
+	JitBytes({0x48, 0x83, 0xC4, 0x08});
+	JitBytes({0x41, 0x5F, 0x41, 0x5E, 0x41, 0x5D, 0x41, 0x5C, 0x5D, 0x5B, 0xC3});
+
+	for (unsigned int i = 0; i <= size; i += 1)
+	{
+		native[i] = jitCode.size();
+
+		if (i == size)
+		{
+			JitExit(size, JIT_BAD_ADDRESS);
+			break;
+		}
+
+		if (leader[i])
+		{
+			// Count the instructions of the block and check the step limit
+			length = 1;
+			while (i + length < size && !leader[i + length])
+				length += 1;
+
+			JitBytes({0x49, 0x81, 0xC6});
+			JitWord32(length);
+			if (maxSteps != 0)
+			{
+				JitBytes({0x4D, 0x39, 0xFE});
+				JitBytes({0x76, 0x11});
+				JitExit(i, JIT_STEP_LIMIT);
+			}
+		}
+
+		word = memory[i];
+		opcode = (unsigned int) ((unsigned long long) word >> 32);
+		address = (unsigned int) (word & 0xffffffffLL);
+
+		if (word < 0 || opcode >= (unsigned int) NUMBER_OF_OPCODES)
+		{
+			JitExit(i, JIT_ILLEGAL);
+			continue;
+		}
+		if (opcode != NOP && opcode != HLT &&
+		    ((opcode == AZJ || opcode == AMJ || opcode == UNJ) ? address > size : address >= size))
+		{
+			JitExit(i, JIT_BAD_ADDRESS);
+			continue;
+		}
+
+		switch (opcode)
+		{
+			case LDA:
+				JitBytes({0x4C, 0x8B, 0xA3});
+				JitWord32(address * 8);
+				break;
+			case STA:
+				JitBytes({0x4C, 0x89, 0xA3});
+				JitWord32(address * 8);
+				break;
+			case IAD:
+				JitBytes({0x4C, 0x03, 0xA3});
+				JitWord32(address * 8);
+				break;
+			case ISB:
+				JitBytes({0x4C, 0x2B, 0xA3});
+				JitWord32(address * 8);
+				break;
+			case IMU:
+				JitBytes({0x4C, 0x0F, 0xAF, 0xA3});
+				JitWord32(address * 8);
+				break;
+			case IDV:
+				// mov rcx, divisor; test rcx, rcx; jnz over the error exit
+				JitBytes({0x48, 0x8B, 0x8B});
+				JitWord32(address * 8);
+				JitBytes({0x48, 0x85, 0xC9, 0x75, 0x11});
+				JitExit(i, JIT_DIVISION_BY_ZERO);
+				// A divisor of -1 negates A without trapping on the smallest integer
+				JitBytes({0x48, 0x83, 0xF9, 0xFF, 0x75, 0x08});
+				JitBytes({0x49, 0xF7, 0xDC, 0x45, 0x31, 0xED, 0xEB, 0x0E});
+				JitBytes({0x4C, 0x89, 0xE0, 0x48, 0x99, 0x48, 0xF7, 0xF9});
+				JitBytes({0x49, 0x89, 0xC4, 0x49, 0x89, 0xD5});
+				break;
+			case AZJ:
+			case AMJ:
+				JitBytes({0x4D, 0x85, 0xE4, 0x0F, (unsigned char) (opcode == AZJ ? 0x84 : 0x88)});
+				jumpPositions.push_back(jitCode.size());
+				jumpTargets.push_back(address);
+				JitWord32(0);
+				break;
+			case UNJ:
+				JitBytes({0xE9});
+				jumpPositions.push_back(jitCode.size());
+				jumpTargets.push_back(address);
+				JitWord32(0);
+				break;
+			case STQ:
+				JitBytes({0x4C, 0x89, 0xAB});
+				JitWord32(address * 8);
+				break;
+			case RDI:
+			case PRI:
+				// mov rdi, rbp; mov esi, address; mov rax, stub; call rax
+				JitBytes({0x48, 0x89, 0xEF, 0xBE});
+				JitWord32(address);
+				JitBytes({0x48, 0xB8});
+				JitWord64((unsigned long long) (opcode == RDI ? &JitRead : &JitWrite));
+				JitBytes({0xFF, 0xD0});
+				break;
+			case NOP:
+				break;
+			case HLT:
+				JitExit(i, JIT_HALT);
+				break;
+		}
+	}
+
+	for (unsigned int i = 0; i < jumpPositions.size(); i += 1)
+		JitPatch(jumpPositions[i], native[jumpTargets[i]]);
+
+	buffer = (unsigned char *) mmap(NULL, jitCode.size(), PROT_READ | PROT_WRITE,
+	                                MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (buffer == MAP_FAILED)
+	{
+		RunThreaded(in, out);
+		return;
+	}
+	for (unsigned int i = 0; i < jitCode.size(); i += 1)
+		buffer[i] = jitCode[i];
+	mprotect(buffer, jitCode.size(), PROT_READ | PROT_EXEC);
+
+	context.a = aRegister;
+	context.q = qRegister;
+	context.count = instructionCount;
+	context.maxSteps = (maxSteps != 0) ? maxSteps : ~0ULL;
+	context.pc = 0;
+	context.data = &memory[0];
+	context.in = &in;
+	context.out = &out;
+
+	status = ((int (*)(long long *, jitContext *)) buffer)(&memory[0], &context);
+	munmap(buffer, jitCode.size());
+
+	aRegister = context.a;
+	qRegister = context.q;
+	instructionCount = context.count;
+
+	if (status == JIT_DIVISION_BY_ZERO)
+		RuntimeError(context.pc, "division by zero");
+	else if (status == JIT_STEP_LIMIT)
+		RuntimeError(context.pc, "step limit exceeded");
+	else if (status == JIT_ILLEGAL)
+		RuntimeError(context.pc, "illegal instruction");
+	else if (status == JIT_BAD_ADDRESS)
+		RuntimeError(context.pc, "address out of range");
+}
+
+void JitBytes(initializer_list<unsigned char> bytes)
+{
+	jitCode.insert(jitCode.end(), bytes);
+}
+
+void JitWord32(unsigned int word)
+{
+	for (int i = 0; i < 4; i += 1)
+		jitCode.push_back((word >> (8 * i)) & 0xff);
+}
+
+void JitWord64(unsigned long long word)
+{
+	for (int i = 0; i < 8; i += 1)
+		jitCode.push_back((word >> (8 * i)) & 0xff);
+}
+
+// Emit the 17 bytes returning status from address pc through the epilogue
+void JitExit(unsigned int pc, int status)
+{
+	JitBytes({0xC7, 0x45, (unsigned char) offsetof(jitContext, pc)});
+	JitWord32(pc);
+	JitBytes({0xB8});
+	JitWord32(status);
+	JitBytes({0xE9});
+	JitWord32(jitEpilogue - (jitCode.size() + 4));
+}
+
+// Point the rel32 at position to the native code at target
+void JitPatch(unsigned int position, unsigned int target)
+{
+	unsigned int displacement = target - (position + 4);
+
+	for (int i = 0; i < 4; i += 1)
+		jitCode[position + i] = (displacement >> (8 * i)) & 0xff;
+}
+
+// Runtime stub for RDI
+void JitRead(jitContext *context, unsigned int address)
+{
+	context->data[address] = ReadInteger(*context->in);
+}
+
+// Runtime stub for PRI
+void JitWrite(jitContext *context, unsigned int address)
+{
+	*context->out << context->data[address] << '\n';
+}
+
+// Replace the modeled cycles with those of a cost model file, in the format
+// the compiler reads: an opcode, its cycles and its size on each line, with
+// anything after '#' a comment
+void LoadCostModel(string fileName)
+{
+	ifstream costFile(fileName.c_str());
+	string line, opcode;
+	int cycles, size, index;
+	unsigned int lineCount = 0;
+
+	if (!costFile)
+	{
+		cerr << "cannot open cost model " << fileName << "\n";
+		exit(1);
+	}
+
+	while (getline(costFile, line))
+	{
+		lineCount += 1;
+
+		if (line.find('#') != string::npos)
+			line.erase(line.find('#'));
+
+		istringstream fields(line);
+		if (!(fields >> opcode))
+			continue;
+
+		index = FindOpcode(opcode);
+		if (index == -1)
+		{
+			cerr << fileName << ":" << lineCount << ": unknown opcode " << opcode << "\n";
+			exit(1);
+		}
+		if (!(fields >> cycles >> size) || cycles < 0 || size < 0)
+		{
+			cerr << fileName << ":" << lineCount << ": expected cycles and size after " << opcode << "\n";
+			exit(1);
+		}
+		opcodeCycles[index] = cycles;
+	}
+}
+
+// Read the line table written by the compiler with --line-table: the
+// source line of each address, followed by the ordinal of its instruction
+// within the line and the hash of the line when the compiler wrote them
+void LoadLineTable(string fileName)
+{
+	ifstream lineTable(fileName.c_str());
+	unsigned int address, line, ordinal, hash;
+	string text;
+
+	if (!lineTable)
+	{
+		cerr << "cannot open line table " << fileName << "\n";
+		exit(1);
+	}
+
+	sourceLine.assign(memory.size(), 0);
+	sourceOrdinal.assign(memory.size(), 0xffffffff);
+	sourceHash.assign(memory.size(), 0);
+	while (getline(lineTable, text))
+	{
+		istringstream fields(text);
+		if (!(fields >> address >> line) || address >= sourceLine.size())
+			continue;
+
+		sourceLine[address] = line;
+		if (fields >> ordinal >> hash)
+		{
+			sourceOrdinal[address] = ordinal;
+			sourceHash[address] = hash;
+		}
+	}
+	hasLineTable = true;
+}
+
+// Write the counts for the compiler's --profile-use: one record per source
+// line and ordinal, "line hash ordinal executed taken", summing the copies
+// of an instruction the compiler made
+void WriteProfileRecords(string fileName)
+{
+	ofstream profileFile(fileName.c_str());
+	map<pair<unsigned int, unsigned int>, unsigned int> hashes;
+	map<pair<unsigned int, unsigned int>, unsigned long long> executed, taken;
+	map<pair<unsigned int, unsigned int>, unsigned int>::iterator record;
+	pair<unsigned int, unsigned int> key;
+
+	for (unsigned int i = 0; i < sourceLine.size(); i += 1)
+	{
+		if (sourceLine[i] == 0 || sourceOrdinal[i] == 0xffffffff)
+			continue;
+
+		key = make_pair(sourceLine[i], sourceOrdinal[i]);
+		hashes[key] = sourceHash[i];
+		executed[key] += executionCounts[i];
+		taken[key] += takenCounts[i];
+	}
+
+	profileFile << "# line hash ordinal executed taken\n";
+	for (record = hashes.begin(); record != hashes.end(); ++record)
+	{
+		key = record->first;
+		profileFile << key.first << " " << record->second << " " << key.second << " " 
+		            << executed[key] << " " << taken[key] << "\n";
+	}
+}
+
+// Roll the execution counts and modeled cycles of every address up to its
+// source line. Print an annotated listing of the source, to standard error
+// unless a file is given, and write the
+// cycles of each line as a collapsed stack, program;line: statement cycles,
+// which flame graph tools read.
+void WriteProfile(string sourceName, string annotateName, string foldedName, string programName)
+{
+	vector<unsigned long long> lineCounts, lineCycles;
+	vector<string> sourceText;
+	unsigned long long totalCycles = 0, cycles;
+	unsigned int lines = 0;
+	string text, frame;
+	ifstream sourceFile;
+	ofstream annotateFile, foldedFile;
+	ostream *annotate = &cerr;
+	int opcode;
+
+	if (sourceName != "")
+	{
+		sourceFile.open(sourceName.c_str());
+		while (getline(sourceFile, text))
+			sourceText.push_back(text);
+	}
+
+	for (unsigned int i = 0; i < sourceLine.size(); i += 1)
+	{
+		if (sourceLine[i] + 1 > lines)
+			lines = sourceLine[i] + 1;
+	}
+	if (sourceText.size() + 1 > lines)
+		lines = sourceText.size() + 1;
+	lineCounts.assign(lines, 0);
+	lineCycles.assign(lines, 0);
+
+	for (unsigned int i = 0; i < executionCounts.size(); i += 1)
+	{
+		if (executionCounts[i] == 0)
+			continue;
+
+		opcode = (int) ((unsigned long long) memory[i] >> 32);
+		cycles = (opcode >= 0 && opcode < NUMBER_OF_OPCODES) ? opcodeCycles[opcode] : 0;
+		lineCounts[sourceLine[i]] += executionCounts[i];
+		lineCycles[sourceLine[i]] += executionCounts[i] * cycles;
+		totalCycles += executionCounts[i] * cycles;
+	}
+
+	if (annotateName != "")
+	{
+		annotateFile.open(annotateName.c_str());
+		annotate = &annotateFile;
+	}
+
+	*annotate << "PROFILE OF " << (sourceName != "" ? sourceName : programName) << ": "
+	          << instructionCount << " INSTRUCTIONS, " << totalCycles << " CYCLES\n\n"
+	          << "    EXECUTED       CYCLES    %  LINE  SOURCE STATEMENT\n\n";
+	for (unsigned int line = 1; line < lines; line += 1)
+	{
+		text = (line <= sourceText.size()) ? sourceText[line - 1] : "";
+		if (lineCounts[line] != 0)
+		{
+			*annotate << setw(12) << lineCounts[line] << setw(13) << lineCycles[line]
+			          << setw(5) << (totalCycles > 0 ? lineCycles[line] * 100 / totalCycles : 0);
+		}
+		else
+		{
+			*annotate << setw(30) << "";
+		}
+		*annotate << setw(6) << line << "| " << text << "\n";
+	}
+
+	if (foldedName != "")
+	{
+		foldedFile.open(foldedName.c_str());
+		programName = programName.substr(programName.find_last_of('/') + 1);
+		programName = programName.substr(0, programName.find('.'));
+		for (unsigned int line = 1; line < lines; line += 1)
+		{
+			if (lineCycles[line] == 0)
+				continue;
+
+			// Semicolons separate frames, so they are dropped from the statement
+			text = (line <= sourceText.size()) ? sourceText[line - 1] : "";
+			frame = "";
+			for (unsigned int j = 0; j < text.length(); j += 1)
+			{
+				if (text[j] != ';' && (text[j] != ' ' || (frame != "" && frame[frame.length() - 1] != ' ')))
+					frame += (text[j] == '\t') ? ' ' : text[j];
+			}
+			while (frame != "" && frame[frame.length() - 1] == ' ')
+				frame.erase(frame.length() - 1);
+
+			foldedFile << programName << ";" << line << (frame != "" ? ": " + frame : "") << " " 
+			           << lineCycles[line] << "\n";
+		}
+	}
+}
+
+// Read the next integer of the input
+long long ReadInteger(istream &in)
+{
+	long long value;
+
+	if (!(in >> value))
+	{
+		cout.flush();
+		cerr << "RAMM: input exhausted or not an integer\n";
+		exit(2);
+	}
+
+	return value;
+}
+
+void CheckAddress(unsigned long long address, unsigned int pc)
+{
+	if (address >= memory.size())
+		RuntimeError(pc, "address out of range");
+}
+
+// Print assembly error message and stop
+void AssemblyError(unsigned int lineNo, string errorMessage)
+{
+	if (lineNo == 0)
+		cerr << "RAMM: " << errorMessage << "\n";
+	else
+		cerr << "RAMM: line " << lineNo << ": " << errorMessage << "\n";
+	exit(1);
+}
+
+// Print an assembly error for the first reference to a label never defined
+void UndefinedLabelError()
+{
+	map<string, vector<fixup> >::iterator it;
+	fixup first = fixups.begin()->second[0];
+
+	for (it = fixups.begin(); it != fixups.end(); ++it)
+	{
+		if (it->second[0].line < first.line)
+			first = it->second[0];
+	}
+
+	AssemblyError(first.line, "undefined label " + first.label);
+}
+
+// Print runtime error message and stop, after the output the program wrote
+void RuntimeError(unsigned int pc, string errorMessage)
+{
+	cout.flush();
+	cerr << "RAMM: address " << pc << ": " << errorMessage << "\n";
+	exit(2);
+}
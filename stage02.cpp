@@ -17,11 +17,23 @@
 #include <string>
 #include <vector>
 #include <stack>
+#include <map>
+#include <unordered_map>
+#include <chrono>
+#include <thread>
+#include <functional>
+#include <algorithm>
+#include <iterator>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
 
 using namespace std;
 
-// Maximum number of entries for the symbol table
-const int MAX_SYMBOL_TABLE_SIZE = 256;
+// Initial and maximum number of entries for the symbol table. The table
+// doubles whenever it fills up, so it always ends in an empty entry.
+const int INITIAL_SYMBOL_TABLE_SIZE = 256;
+const int MAX_SYMBOL_TABLE_SIZE = 16777216;
 
 // Enums
 enum storeType {INTEGER, BOOLEAN, PROG_NAME, UNKNOWN};
@@ -40,8 +52,65 @@ struct entry
 	int units;
 };
 
-// Vector holding the symbol table
+// Vector holding the symbol table, the number of entries in use, and the
+// index of every external name
 vector<entry> symbolTable;
+unsigned int symbolCount = 0;
+unordered_map<string, int> symbolIndex;
+
+// Index of the first boolean constant with the value true and with the value
+// false, or -1, kept by Insert for the true and false literals of Code
+int indexOfTrue = -1;
+int indexOfFalse = -1;
+
+// Define object code instruction format
+struct instruction
+{
+	string label;
+	string opcode;
+	string operand;
+	string remark;
+	unsigned int line;
+	unsigned int ordinal;
+};
+
+// Vector holding the object code until it is written to the object file
+vector<instruction> objectCode;
+
+// Define bytecode instruction format for --run. Operands are slots: indexes
+// of symbol table entries.
+enum runOpcodes {RUN_ADD, RUN_SUB, RUN_MUL, RUN_DIV, RUN_MOD, RUN_AND, RUN_OR, RUN_EQ, RUN_NE, 
+                 RUN_LT, RUN_LE, RUN_GT, RUN_GE, RUN_NEG, RUN_NOT, RUN_MOVE, RUN_READ, RUN_WRITE, 
+                 RUN_JUMP, RUN_JUMP_IF_FALSE, RUN_HALT};
+struct runInstruction
+{
+	runOpcodes opcode;
+	int result;
+	int operand1;
+	int operand2;
+};
+
+// Define profile record format. A record counts the executions of the
+// instruction emitted ordinal-th for a source line, and how often it jumped.
+struct profileRecord
+{
+	unsigned int line;
+	unsigned int hash;
+	unsigned int ordinal;
+	long long executed;
+	long long taken;
+};
+
+// Define basic block format for the control flow graph of the object code
+struct block
+{
+	int first;
+	int last;
+	int predecessors;
+	bool fallsIn;
+	bool reachable;
+	bool placed;
+};
 
 // Input file
 ifstream sourceFile;
@@ -49,15 +118,34 @@ ifstream sourceFile;
 // List and object output files
 ofstream listingFile, objectFile;
 
-// Variables that might be used by any of the functions
-string token;
-bool printLineNumber = false;
-char charac;
+// Variables that might be used by any of the functions. The lexer, the
+// parser and the listing writer of --pipeline each keep their own token,
+// character and line. Being thread local costs the compiler on one thread
+// nothing measurable: --check and -O0 on a 5 MB program and the lexer
+// microbenchmarks time the same within noise as with plain globals.
+thread_local string token;
+thread_local bool printLineNumber = false;
+thread_local char charac;
 const char END_OF_FILE = '$'; // arbitrary choice
-unsigned int lineNumber = 0;
+thread_local unsigned int lineNumber = 0;
 unsigned int integerCount = 0;
 unsigned int booleanCount = 0;
 
+// Error recovery. Error() throws a compileError until maxErrors errors have
+// been reported (0 means no limit); the statement and declaration loops
+// catch it and skip to the next statement or declaration. tokenCount tells
+// whether the failed construct consumed any token, and no error is reported
+// while recovering skips tokens. A statement may not pop the operands below
+// operandBase, which belong to the statements enclosing it.
+struct compileError
+{
+};
+unsigned int maxErrors = 1;
+unsigned int errorCount = 0;
+thread_local unsigned long long tokenCount = 0;
+bool recovering = false;
+unsigned int operandBase = 0;
+
 // Stage 1
 stack<string> operandStk;
 stack<string> operatorStk;
@@ -66,6 +154,183 @@ int currentTempNo = -1;
 int currentLabelNo = -1;
 int maxTempNo = -1;
 
+// Whether each temporary holds a value known to be 0 or 1, such as the result
+// of a comparison. A boolean read from input may hold any integer, so the
+// arithmetic forms of not, and and or are only used on known 0/1 operands.
+vector<bool> zeroOrOneTemps;
+
+// Whether the predicate of each while loop, by the label that follows the
+// loop, is known to be 0 or 1, so that rotate-loops may negate it arithmetically
+unordered_map<string, bool> zeroOrOnePredicates;
+
+// Optimization passes. rotate-loops and lower-booleans change how the Emit
+// functions generate code; the others rewrite the object code after parsing.
+const int NUMBER_OF_PASSES = 4;
+const string PASS_NAMES[NUMBER_OF_PASSES] = 
+	{"rotate-loops", "lower-booleans", "peephole", "layout-blocks"};
+
+// Passes to run in order, and the passes switched off or printed after
+vector<string> passPipeline;
+vector<string> disabledPasses;
+vector<string> printAfterPasses;
+
+// Time spent in each phase, in the order the phases ran
+vector<string> phaseNames;
+vector<double> phaseSeconds;
+
+// Optimization switches
+bool rotateLoops = false;
+bool lowerBooleans = false;
+bool optimizeForSize = false;
+
+// Threads that share the peephole rewrite and the formatting of the object
+// code: --jobs=n, by default 1, so a compile starts no threads unless asked
+// to. The object code is split only into chunks of at least MINIMUM_CHUNK
+// instructions, so small programs stay on one thread even then, and the
+// chunks are joined in order, so the output is the same for any number of
+// threads.
+unsigned int jobs = 1;
+const unsigned int MINIMUM_CHUNK = 65536;
+
+// Cost model: estimated cycles and size in words of each RAMM instruction.
+// The defaults can be replaced with --cost-model=file to match a target board.
+const int NUMBER_OF_OPCODES = 14;
+const string OPCODES[NUMBER_OF_OPCODES] = 
+	{"LDA", "STA", "IAD", "ISB", "IMU", "IDV", "AZJ", "AMJ", "UNJ", "STQ", "RDI", "PRI", "NOP", "HLT"};
+int opcodeCycles[NUMBER_OF_OPCODES] = 
+	{  2,     2,     2,     2,     4,     6,     2,     2,     2,     2,    10,    10,     1,     1};
+int opcodeSize[NUMBER_OF_OPCODES] = 
+	{  1,     1,     1,     1,     1,     1,     1,     1,     1,     1,     1,     1,     1,     1};
+
+// Command line options
+bool costReport = false;
+bool timePasses = false;
+string lineTableName = "";
+string timeReport = "";
+
+// Phases and counters of --time-report. The instrumentation is compiled in
+// with -DTIME_REPORT; otherwise TIME_SCOPE and COUNT expand to nothing. A
+// TIME_SCOPE charges the time until the end of its block to a phase and stops
+// charging the phase it interrupted, so every phase counts its own time only.
+enum reportPhases {PHASE_PARSE, PHASE_LEX, PHASE_LOOKUP, PHASE_EMIT, PHASE_OPTIMIZE, PHASE_OUTPUT};
+const int NUMBER_OF_REPORT_PHASES = 6;
+const string REPORT_PHASE_NAMES[NUMBER_OF_REPORT_PHASES] = 
+	{"parse", "lex", "lookup", "emit", "optimize", "output"};
+enum reportCounters {COUNT_TOKENS, COUNT_LOOKUPS, COUNT_PROBES, COUNT_SYMBOLS, COUNT_TEMPS, COUNT_LABELS, 
+                     COUNT_INSTRUCTIONS, COUNT_OBJECT_BYTES, COUNT_LISTING_BYTES};
+const int NUMBER_OF_COUNTERS = 9;
+const string COUNTER_NAMES[NUMBER_OF_COUNTERS] = 
+	{"tokens", "lookups", "probes", "symbols", "temps", "labels", "instructions", "object_bytes", "listing_bytes"};
+
+#ifdef TIME_REPORT
+struct reportScope
+{
+	reportPhases interrupted;
+	reportScope(reportPhases phase);
+	~reportScope();
+};
+
+double reportSeconds[NUMBER_OF_REPORT_PHASES];
+unsigned long long reportCounts[NUMBER_OF_COUNTERS];
+reportPhases reportPhase = PHASE_PARSE;
+chrono::steady_clock::time_point reportSwitch = chrono::steady_clock::now();
+
+#define TIME_SCOPE(phase) reportScope timeScope(phase)
+#define COUNT(counter, n) (reportCounts[counter] += (n))
+#else
+#define TIME_SCOPE(phase)
+#define COUNT(counter, n)
+#endif
+
+// Hash of every source line, and the line and ordinal of the last instruction
+// emitted, which number the instructions emitted for each line
+vector<unsigned int> sourceLineHashes;
+unsigned int emitLine = 0;
+unsigned int emitOrdinal = 0;
+
+// Profile read with --profile-use: the records of each line and ordinal of
+// the profiled program, and the line of that program each source line
+// matches
+bool profileLoaded = false;
+map<unsigned long long, profileRecord> profileRecords;
+map<unsigned int, long long> profileLineCounts;
+map<unsigned int, unsigned int> profileLines;
+
+// Target the object code is written for: ramm, x86_64 or c
+string target = "ramm";
+
+// C program for --target=c: the expression of each live temporary, the
+// statements written so far and their indentation
+map<string, string> cExpressions;
+vector<string> cStatements;
+int cIndent = 1;
+
+// Bytecode for --run, the position of each label and the jumps waiting for
+// labels not defined yet
+bool runProgram = false;
+vector<runInstruction> runCode;
+map<string, int> runLabels;
+map<string, vector<int> > runPending;
+
+// --check only lexes, parses and type checks: there is no listing echo, no
+// code and no temporary or label but the placeholders of CheckCode
+bool checkOnly = false;
+
+// --pipeline lexes on a thread of its own, which hands each token to the
+// parser through a ring with its line, the number of source characters read
+// and any error. The lexer runs ahead of the parser until an error leaves no
+// token; then it waits to be told to lex again or to pass over a character,
+// as SkipToken would. A writer thread echoes the source to the listing up to
+// the position of each error, or of every LISTING_INTERVAL-th token, that
+// the parser sends it through a second ring. Each ring has one producer and
+// one consumer, which only wait when it is empty or full. A waiting thread
+// yields PIPELINE_SPINS times, then sleeps on the signal of what it waits
+// for until the other thread changes it, as a futex would.
+struct pipelineRecord
+{
+	string text;
+	string error;
+	unsigned int line;
+	unsigned long long position;
+	bool last;
+};
+struct pipelineSignal
+{
+	mutex lock;
+	condition_variable changed;
+	atomic<unsigned int> sleepers;
+};
+struct pipelineRing
+{
+	vector<pipelineRecord> records;
+	atomic<unsigned long long> head;
+	atomic<unsigned long long> tail;
+	pipelineSignal signal;
+};
+enum lexerCommands {LEXER_WAIT, LEXER_NEXT, LEXER_SKIP};
+const unsigned int PIPELINE_SPINS = 64;
+const unsigned int TOKEN_RING_SIZE = 4096;
+const unsigned int LISTING_RING_SIZE = 256;
+const unsigned int LISTING_INTERVAL = 4096;
+bool pipelined = false;
+pipelineRing tokenRing, listingRing;
+atomic<int> lexerCommand(LEXER_WAIT);
+pipelineSignal commandSignal;
+atomic<bool> pipelineStopping(false);
+thread lexerThread, writerThread;
+thread_local bool lexingThread = false;
+thread_local bool echoSource = true;
+string lexerError;
+bool lexerWaiting = false;
+unsigned long long sourcePosition = 0;
+unsigned long long listingPosition = 0;
+pipelineRecord lastToken;
+
+// When the compiler started, and how long after that the program run by
+// --run wrote its first output
+chrono::steady_clock::time_point programStart = chrono::steady_clock::now();
+double firstOutputSeconds = -1;
+
 // Function prototypes (stage 0)
 void CreateListingHeader();
 void Parser();
@@ -76,7 +341,9 @@ void Consts();
 void Vars();
 void BeginEndStmt(bool internalBeginEnd);
 void ConstStmts();
+void ConstStmt();
 void VarStmts();
+void VarStmt();
 string Ids();
 void Insert(string externalName, storeType inType, modes inMode, string inValue, allocation inAlloc, int inUnits);
 storeType WhichType(string name);
@@ -84,6 +351,8 @@ string WhichValue(string name);
 string NextToken();
 char NextChar();
 void Error(string errorMessage);
+void Synchronize(string stopTokens, unsigned long long start);
+void SkipToken();
 bool CheckNonKeyID(string currentToken);
 bool CheckForKeyword(string word);
 string GenInternalName(storeType type);
@@ -95,13 +364,12 @@ void ReadStmt();
 void WriteStmt();
 void AssignStmt();
 void Express();
-void Term();
-void Factor();
-void Terms();
-void Expresses();
-void Part();
-void Factors();
+int OperatorPrecedence(string oper_ator);
 void Code(string oper_ator, string operand1 = "", string operand2 = "");
+string MapBooleanLiteral(string operand);
+void CheckCode(string oper_ator, string operand1, string operand2);
+storeType CheckType(string operand);
+string CheckResult(storeType type);
 void EmitReadCode(string operand1);
 void EmitWriteCode(string operand1);
 void EmitAdditionCode(string operand1, string operand2);
@@ -127,6 +395,7 @@ bool IsTokenAnInt(string name);
 bool IsTokenABool(string name);
 bool IsNameInSymbolTable(string name);
 bool CheckForTempName(string name);
+bool IsZeroOrOne(string name);
 void FreeTemp();
 string GetTemp();
 string GetLabel();
@@ -136,6 +405,7 @@ string PopOperator();
 string PopOperand();
 modes WhichMode(string name);
 int FindIndex(string name);
+int FindSymbol(string name);
 int FindIndexOfTrue();
 int FindIndexOfFalse();
 
@@ -153,25 +423,300 @@ void EmitPostWhileCode(string operand1, string operand2);
 void EmitRepeatCode();
 void EmitUntilCode(string operand1, string operand2);
 
+// Function prototypes (object code)
+void Emit(string label, string opcode, string operand, string remark);
+void WriteObjectCode();
+int FindOpcode(string opcode);
+int InstructionCost(string opcode, unsigned int line = lineNumber);
+int InstructionSize(string opcode);
+void LoadCostModel(string fileName);
+void CreateCostReport(string sourceName);
+void WriteLineTable(string fileName);
+void HashSourceLines(string fileName);
+void LoadProfile(string fileName);
+long long ProfileCount(unsigned int line, unsigned int ordinal, bool taken);
+bool IsColdLine(unsigned int line);
+bool RotateLoop(string exitLabel, string headLabel);
+void LayoutBlocks();
+void ChainHotBlocks(vector<block> &blocks, vector<int> &target, vector<int> &blockOf, vector<int> &order);
+void Peephole();
+void PeepholeChunk(unsigned int first, unsigned int last, vector<instruction> &newCode);
+void PrintObjectCode(ostream &out);
+void PrintObjectCodeChunk(unsigned int first, unsigned int last, unsigned int labelWidth,
+                          unsigned int operandWidth, ostream &out);
+vector<unsigned int> SplitObjectCode(bool atLabels);
+bool SetOptimizationLevel(string level);
+bool CheckForPassName(string name);
+bool IsPassEnabled(string name);
+bool IsNameInList(string name, const vector<string> &list);
+vector<string> SplitList(string list);
+void RunPasses();
+void RecordPhase(string name, chrono::steady_clock::time_point start);
+void CreatePassTimeReport();
+void CreateTimeReport();
+bool CheckForJump(string opcode);
+bool CheckForLabelName(string name);
+
+// Function prototypes (pipeline)
+void StartPipeline(string sourceName);
+void StopPipeline();
+void LexerThread();
+void WriterThread(string sourceName);
+string ReceiveToken();
+void PostListing(string text, bool last);
+void SkipCharacter();
+void EchoCharacter(char c);
+bool PushRecord(pipelineRing &ring, pipelineRecord &record);
+template <typename T> void WaitForChange(pipelineSignal &signal, atomic<T> &value, T seen);
+void WakeWaiters(pipelineSignal &signal);
+void SendLexerCommand(int command);
+void PopRecord(pipelineRing &ring, pipelineRecord &record);
+
+// Function prototypes (targets)
+void WriteAssemblyCode();
+void EmitCCode(string oper_ator, string operand1, string operand2);
+string CExpression(string name);
+string CName(string name);
+string StripParentheses(string expression);
+void CStatement(string statement);
+void WriteCCode();
+void EmitRunCode(string oper_ator, string operand1, string operand2);
+void RunInstruction(runOpcodes opcode, int result, int operand1, int operand2);
+void RunLabel(string label);
+void RunProgram();
+
+// bench/microbench.cpp includes this file with STAGE02_NO_MAIN defined to
+// call the lexer, the symbol table and the emitters directly
+#ifndef STAGE02_NO_MAIN
 int main(int argc, char **argv)
 {
 	// This program is the stage0 compiler for Pascallite. It will accept
-	// input from argv[1], generating a listing to argv[2], and object code to
-	// argv[3].
-	sourceFile.open(argv[1]);
-	listingFile.open(argv[2]);
-	objectFile.open(argv[3]);
+	// input from the first file name, generating a listing to the second, and
+	// object code to the third. Options may appear anywhere on the line.
+	vector<string> fileNames, passNames;
+	string option, profileName = "";
+	chrono::steady_clock::time_point start;
+	
+	SetOptimizationLevel("-O1");
+	
+	for (int i = 1; i < argc; i += 1)
+	{
+		option = argv[i];
+		
+		if (option == "--cost-report")
+		{
+			costReport = true;
+		}
+		else if (option.substr(0, 13) == "--cost-model=")
+		{
+			LoadCostModel(option.substr(13));
+		}
+		else if (option.substr(0, 2) == "-O")
+		{
+			if (!SetOptimizationLevel(option))
+			{
+				cerr << "unknown optimization level " << option << "\n";
+				return 1;
+			}
+		}
+		else if (option.substr(0, 9) == "--passes=" ||
+		         option.substr(0, 15) == "--disable-pass=" ||
+		         option.substr(0, 14) == "--print-after=")
+		{
+			passNames = SplitList(option.substr(option.find('=') + 1));
+			for (unsigned int j = 0; j < passNames.size(); j += 1)
+			{
+				if (!CheckForPassName(passNames[j]))
+				{
+					cerr << "unknown pass " << passNames[j] << "\n";
+					return 1;
+				}
+			}
+			
+			if (option[2] == 'p' && option[3] == 'a')
+				passPipeline = passNames;
+			else if (option[2] == 'd')
+				disabledPasses.insert(disabledPasses.end(), passNames.begin(), passNames.end());
+			else
+				printAfterPasses.insert(printAfterPasses.end(), passNames.begin(), passNames.end());
+		}
+		else if (option == "--time-passes")
+		{
+			timePasses = true;
+		}
+		else if (option.substr(0, 13) == "--time-report")
+		{
+			timeReport = option.length() > 14 ? option.substr(14) : "table";
+			if ((option.length() > 13 && option[13] != '=') || (timeReport != "table" && timeReport != "json"))
+			{
+				cerr << "unknown time report format " << option << "\n";
+				return 1;
+			}
+#ifndef TIME_REPORT
+			cerr << "--time-report needs a compiler built with -DTIME_REPORT\n";
+			return 1;
+#endif
+		}
+		else if (option.substr(0, 13) == "--line-table=")
+		{
+			lineTableName = option.substr(13);
+		}
+		else if (option.substr(0, 14) == "--profile-use=")
+		{
+			profileName = option.substr(14);
+		}
+		else if (option == "--run")
+		{
+			runProgram = true;
+		}
+		else if (option == "--check")
+		{
+			checkOnly = true;
+		}
+		else if (option == "--pipeline")
+		{
+			pipelined = true;
+#ifdef TIME_REPORT
+			cerr << "--pipeline needs a compiler built without -DTIME_REPORT\n";
+			return 1;
+#endif
+		}
+		else if (option.substr(0, 13) == "--max-errors=")
+		{
+			if (option.length() == 13 || option.find_first_not_of("0123456789", 13) != string::npos)
+			{
+				cerr << "illegal error limit " << option << "\n";
+				return 1;
+			}
+			maxErrors = atoi(option.substr(13).c_str());
+		}
+		else if (option.substr(0, 7) == "--jobs=")
+		{
+			if (option.length() == 7 || option.find_first_not_of("0123456789", 7) != string::npos ||
+			    atoi(option.substr(7).c_str()) == 0)
+			{
+				cerr << "illegal job count " << option << "\n";
+				return 1;
+			}
+			jobs = atoi(option.substr(7).c_str());
+		}
+		else if (option.substr(0, 9) == "--target=")
+		{
+			target = option.substr(9);
+			if (target != "ramm" && target != "x86_64" && target != "c")
+			{
+				cerr << "unknown target " << target << "\n";
+				return 1;
+			}
+		}
+		else if (option[0] == '-' && option.length() > 1)
+		{
+			cerr << "unknown option " << option << "\n";
+			return 1;
+		}
+		else
+		{
+			fileNames.push_back(option);
+		}
+	}
+	
+	if (fileNames.size() != (runProgram || checkOnly ? 1 : 3) || (runProgram && checkOnly))
+	{
+		cerr << "usage: " << argv[0] << " [-O0|-O1|-O2|-Os] [--passes=list] [--disable-pass=list]\n"
+		     << "       [--print-after=list] [--time-passes] [--cost-model=file] [--cost-report]\n"
+		     << "       [--target=ramm|x86_64|c] [--line-table=file] [--profile-use=file]\n"
+		     << "       [--time-report[=table|json]] [--max-errors=n] [--jobs=n] [--pipeline]\n"
+		     << "       source listing object\n"
+		     << "   or: " << argv[0] << " --run [--time-passes] [--time-report[=table|json]] [--max-errors=n] source\n"
+		     << "   or: " << argv[0] << " --check [--time-passes] [--time-report[=table|json]] [--max-errors=n] source\n";
+		return 1;
+	}
 	
-	symbolTable.resize(MAX_SYMBOL_TABLE_SIZE);
+	rotateLoops = IsPassEnabled("rotate-loops");
+	lowerBooleans = IsPassEnabled("lower-booleans");
 	
-	for (int i = 0; i < MAX_SYMBOL_TABLE_SIZE; i += 1)
+	if (lineTableName != "" || profileName != "")
+		HashSourceLines(fileNames[0]);
+	if (profileName != "")
+		LoadProfile(profileName);
+	
+	sourceFile.open(fileNames[0].c_str());
+	if (!runProgram && !checkOnly)
 	{
-		symbolTable[i].externalName = "";
+		listingFile.open(fileNames[1].c_str());
+		objectFile.open(fileNames[2].c_str());
 	}
 	
+	symbolTable.resize(INITIAL_SYMBOL_TABLE_SIZE);
+	
+#ifdef TIME_REPORT
+	reportSwitch = chrono::steady_clock::now();
+#endif
 	CreateListingHeader();
+	start = chrono::steady_clock::now();
+	if (pipelined)
+		StartPipeline(fileNames[0]);
+	else
+		echoSource = !checkOnly;
 	Parser();
+	StopPipeline();
+	RecordPhase("parse", start);
+	
+	// Errors below the limit were recovered from: the program is neither run
+	// nor optimized, and the object code generated is kept as it is
+	if (errorCount > 0)
+	{
+		if (target == "ramm" && !checkOnly)
+			WriteObjectCode();
+		CreateListingTrailer();
+		if (timePasses)
+			CreatePassTimeReport();
+		if (timeReport != "")
+			CreateTimeReport();
+		return 1;
+	}
+	
+	// --check is done once the program parses and type checks
+	if (checkOnly)
+	{
+		if (timePasses)
+			CreatePassTimeReport();
+		if (timeReport != "")
+			CreateTimeReport();
+		return 0;
+	}
+	
+	// --run executes the program instead of writing a listing and object code
+	if (runProgram)
+	{
+		start = chrono::steady_clock::now();
+		RunProgram();
+		RecordPhase("run", start);
+		if (timePasses)
+			CreatePassTimeReport();
+		if (timeReport != "")
+			CreateTimeReport();
+		return 0;
+	}
+	
+	RunPasses();
+	if (costReport)
+		CreateCostReport(fileNames[0]);
+	if (lineTableName != "" && target == "ramm")
+		WriteLineTable(lineTableName);
+	if (target == "x86_64")
+		WriteAssemblyCode();
+	else if (target == "c")
+		WriteCCode();
+	else
+		WriteObjectCode();
 	CreateListingTrailer();
+	COUNT(COUNT_OBJECT_BYTES, objectFile.tellp());
+	COUNT(COUNT_LISTING_BYTES, listingFile.tellp());
+	if (timePasses)
+		CreatePassTimeReport();
+	if (timeReport != "")
+		CreateTimeReport();
 	
 	sourceFile.close();
 	listingFile.close();
@@ -179,6 +724,7 @@ int main(int argc, char **argv)
 
 	return 0;
 }
+#endif
 
 void CreateListingHeader()
 {
@@ -191,29 +737,38 @@ void CreateListingHeader()
 
 void Parser()
 {
-	// Charac must be initialized to the first character of the source file
-	NextChar();
+	// Charac must be initialized to the first character of the source file,
+	// which the lexer thread of --pipeline reads itself
+	if (!pipelined)
+		NextChar();
 	
 	// A call to NextToken() has two effects
 	// (1) the variable, token, is assigned the value of the next token
 	// (2) the next token is read from the source file in order to make
 	// the assignment. The value returned by NextToken() is also
 	// the next token.
-	if (NextToken() != "program")
+	//
+	// Parser implements the grammar rules, calling first rule. An error
+	// outside of any statement or declaration ends the parse.
+	try
+	{
+		if (NextToken() != "program")
+		{
+			Error("Keyword \"program\" expected");
+		}
+		
+		Prog();
+	}
+	catch (compileError &)
 	{
-		Error("Keyword \"program\" expected");
 	}
-	
-	// Parser implements the grammar rules, calling first rule
-	Prog();
-	
 }
 
-// Prints the end of the listing file to the listing file. If the compiler
-// makes it here, there weren't any errors.
+// Prints the end of the listing file to the listing file, with the number
+// of errors reported
 void CreateListingTrailer()
 {
-	listingFile << "\nCOMPILATION TERMINATED      0 ERRORS ENCOUNTERED\n";
+	listingFile << "\nCOMPILATION TERMINATED" << right << setw(7) << errorCount << " ERRORS ENCOUNTERED\n";
 }
 
 // Token should be "program"
@@ -330,15 +885,48 @@ void BeginEndStmt(bool internalBeginEnd)
 	}
 }
 
-// Token should be read, write, a non-key ID, or end
+// Token should be read, write, a non-key ID, or end. The statements are
+// parsed in a loop, so a long statement list does not deepen the stack.
+// After an error, whatever the statement left on the stacks is dropped and
+// parsing resumes after the next ';', or at the next end, until or keyword
+// that begins a statement. An else after the ';' belonged to a failed if,
+// and the statement after it is parsed on its own.
 void ExecStmts()
 {
-	if (token != "end" && token != "until" && token != "do")
+	unsigned int operands, operators, enclosingBase = operandBase;
+	int tempNo;
+	unsigned long long start;
+	
+	while (token != "end" && token != "until" && token != "do")
 	{
-		ExecStmt();
+		operands = operandStk.size();
+		operators = operatorStk.size();
+		tempNo = currentTempNo;
+		start = tokenCount;
+		operandBase = operands;
 		
-		ExecStmts();
+		try
+		{
+			ExecStmt();
+		}
+		catch (compileError &)
+		{
+			while (operandStk.size() > operands)
+				operandStk.pop();
+			while (operatorStk.size() > operators)
+				operatorStk.pop();
+			currentTempNo = tempNo;
+			currentARegister = "";
+			
+			Synchronize("; end until begin if while repeat", start);
+			if (token == ";")
+				SkipToken();
+			if (token == "else")
+				SkipToken();
+		}
 	}
+	
+	operandBase = enclosingBase;
 }
 
 void ExecStmt()
@@ -452,10 +1040,9 @@ void AssignStmt()
 	if (token != ";")
 		Error("semicolon expected");
 	
-	string operand1 = operandStk.top();
-	operandStk.pop();
-	string operand2 = operandStk.top();
-	operandStk.pop();
+	// A missing expression leaves only the target: underflow is an error
+	string operand1 = PopOperand();
+	string operand2 = PopOperand();
 	
 	Code(PopOperator(), operand1, operand2);
 }
@@ -558,203 +1145,194 @@ void RepeatStmt()
 	Code("until", operand1, operand2);
 }
 
+// Parse an expression with an explicit stack instead of recursion, so its
+// length and its parentheses do not deepen the C++ stack. Operators wait on
+// operatorStk above the operators of the enclosing statement until an
+// operator of no higher precedence, or the end of the expression, follows
+// their right operand, and are then generated in the order of the grammar:
+//   expression = term {relational term}, term = factor {add factor},
+//   factor = part {mult part}
+// An open parenthesis waits on operatorStk as a marker: "(" alone or after
+// '+', "not(" after not and "neg(" after '-'. Token is the token before the
+// expression; it is the token after the expression on return.
 void Express()
 {
-	Term();
-	
-	Expresses();
-}
-
-void Term()
-{
-	Factor();
-	
-	Terms();
-}
-
-void Factor()
-{
-	Part();
-	
-	Factors();
-}
-
-void Terms()
-{
-	if (CheckForAddLevOperator(token))
-	{
-		PushOperator(token);
-		
-		Factor();
-		
-		string operand1 = operandStk.top();
-		operandStk.pop();
-		string operand2 = operandStk.top();
-		operandStk.pop();
-		
-		Code(PopOperator(), operand1, operand2);
-		
-		Terms();
-	}
-}
-
-void Expresses()
-{
-	if (CheckForRelationalOperator(token))
-	{
-		PushOperator(token);
-		
-		Term();
-		
-		string operand1 = operandStk.top();
-		operandStk.pop();
-		string operand2 = operandStk.top();
-		operandStk.pop();
-		
-		Code(PopOperator(), operand1, operand2);
-		
-		Expresses();
-	}
-}
-
-void Factors()
-{
-	if (CheckForMultLevOperator(token))
-	{
-		PushOperator(token);
-		
-		Part();
-		
-		string operand1 = operandStk.top();
-		operandStk.pop();
-		string operand2 = operandStk.top();
-		operandStk.pop();
-		
-		Code(PopOperator(), operand1, operand2);
-		
-		Factors();
-	}
-}
-
-void Part()
-{
-	NextToken();
+	unsigned int base = operatorStk.size();
+	bool expectOperand = true;
+	string marker;
 	
-	if (token == "not")
+	while (true)
 	{
-		token = NextToken();
-		if (token == "(")
+		if (expectOperand)
 		{
-			Express();
+			// Parse a part, or open a parenthesis and parse the part after it
+			NextToken();
+			expectOperand = false;
 			
-			if (token != ")")
+			if (token == "not")
 			{
-				Error("\')\' expected");
+				token = NextToken();
+				if (token == "(")
+				{
+					PushOperator("not(");
+					expectOperand = true;
+				}
+				else if (token == "false")
+				{
+					PushOperand("true");
+				}
+				else if (token == "true")
+				{
+					PushOperand("false");
+				}
+				else if (CheckNonKeyID(token))
+				{
+					Code("not", token);
+				}
+				else
+				{
+					Error("illegal symbol follows \"not\"");
+				}
+			}
+			else if (token == "+")
+			{
+				token = NextToken();
+				if (token == "(")
+				{
+					PushOperator("(");
+					expectOperand = true;
+				}
+				else if (IsTokenAnInt(token) || CheckNonKeyID(token))
+				{
+					PushOperand(token);
+				}
+				else
+				{
+					Error("illegal symbol follows \'+\'");
+				}
+			}
+			else if (token == "-")
+			{
+				token = NextToken();
+				if (token == "(")
+				{
+					PushOperator("neg(");
+					expectOperand = true;
+				}
+				else if (IsTokenAnInt(token))
+				{
+					PushOperand("-" + token);
+				}
+				else if (CheckNonKeyID(token))
+				{
+					Code("neg", token);
+				}
+				else
+				{
+					Error("illegal symbol follows \'-\'");
+				}
+			}
+			else if (token == "(")
+			{
+				PushOperator("(");
+				expectOperand = true;
+			}
+			else if (IsTokenAnInt(token) || IsTokenABool(token) || CheckNonKeyID(token))
+			{
+				PushOperand(token);
+			}
+			else
+			{
+				// No part: leave the token for the caller to reject
+				continue;
 			}
 			
-			Code("not", PopOperand());
-		}
-		else if (token == "false")
-		{
-			PushOperand("true");
-		}
-		else if (token == "true")
-		{
-			PushOperand("false");
-		}
-		else if (CheckNonKeyID(token))
-		{
-			Code("not", token);
-		}
-		else
-		{
-			Error("illegal symbol follows \"not\"");
+			if (!expectOperand)
+				NextToken();
 		}
-		
-		NextToken();
-	}
-	else if (token == "+")
-	{
-		token = NextToken();
-		if (token == "(")
+		else if (OperatorPrecedence(token) > 0)
 		{
-			Express();
-			
-			if (token != ")")
+			// Generate the waiting operators that bind at least as tightly
+			while (operatorStk.size() > base &&
+			       OperatorPrecedence(operatorStk.top()) >= OperatorPrecedence(token))
 			{
-				Error("\')\' expected");
+				string operand1 = PopOperand();
+				string operand2 = PopOperand();
+				
+				Code(PopOperator(), operand1, operand2);
 			}
-		}
-		else if (IsTokenAnInt(token) || CheckNonKeyID(token))
-		{
-			PushOperand(token);
+			
+			PushOperator(token);
+			expectOperand = true;
 		}
 		else
 		{
-			Error("illegal symbol follows \'+\'");
-		}
-		
-		NextToken();
-	}
-	else if (token == "-")
-	{
-		token = NextToken();
-		if (token == "(")
-		{
-			Express();
+			// The expression, or the parenthesized expression, ends here
+			while (operatorStk.size() > base && OperatorPrecedence(operatorStk.top()) > 0)
+			{
+				string operand1 = PopOperand();
+				string operand2 = PopOperand();
+				
+				Code(PopOperator(), operand1, operand2);
+			}
+			
+			if (operatorStk.size() == base)
+				return;
 			
 			if (token != ")")
 			{
 				Error("\')\' expected");
 			}
 			
-			Code("neg", PopOperand());
-		}
-		else if (IsTokenAnInt(token))
-		{
-			PushOperand("-" + token);
-		}
-		else if (CheckNonKeyID(token))
-		{
-			Code("neg", token);
+			marker = PopOperator();
+			if (marker == "not(")
+				Code("not", PopOperand());
+			else if (marker == "neg(")
+				Code("neg", PopOperand());
+			
+			NextToken();
 		}
-		else
-		{
-			Error("illegal symbol follows \'-\'");
-		}
-		
-		NextToken();
 	}
-	else if (token == "(")
-	{
-		Express();
+}
 
-		if (token != ")")
-		{
-			Error("\')\' expected");
-		}
-		
-		NextToken();
-	}
-	else if (IsTokenAnInt(token) || IsTokenABool(token) || CheckNonKeyID(token))
-	{
-		PushOperand(token);
-		NextToken();
-	}
+// Returns the precedence of a binary operator: 3 for multiplying operators,
+// 2 for adding operators, 1 for relational operators and 0 for anything
+// else, such as a parenthesis marker
+int OperatorPrecedence(string oper_ator)
+{
+	if (CheckForMultLevOperator(oper_ator))
+		return 3;
+	if (CheckForAddLevOperator(oper_ator))
+		return 2;
+	if (CheckForRelationalOperator(oper_ator))
+		return 1;
+	
+	return 0;
 }
 
 void Code(string oper_ator, string operand1, string operand2)
 {
+	TIME_SCOPE(PHASE_EMIT);
+	
+	operand1 = MapBooleanLiteral(operand1);
+	operand2 = MapBooleanLiteral(operand2);
+	
+	if (checkOnly)
+	{
+		CheckCode(oper_ator, operand1, operand2);
+		return;
+	}
+	
 	if (oper_ator == "program")
 	{
-		objectFile << "STRT  NOP          " << symbolTable[0].externalName << " - BRIAN LEARY, JOSEPH LYNCH\n";
+		Emit("STRT", "NOP", "", symbolTable[0].externalName + " - BRIAN LEARY, JOSEPH LYNCH");
 	}
 		
 	else if (oper_ator == "end")
 	{
 		if (operand1 == ".")
 		{
-			objectFile << "      HLT          \n";
+			Emit("", "HLT", "", "");
 			
 			for (unsigned int i = 0; i < symbolTable.size(); i += 1)
 			{
@@ -768,39 +1346,36 @@ void Code(string oper_ator, string operand1, string operand2)
 					{
 						if (symbolTable[i].mode == CONSTANT)
 						{
-							objectFile << setw(4) << left << symbolTable[i].internalName;
-							objectFile << "  DEC ";
+							string tempString = "";
 							
 							if (symbolTable[i].value[0] == '-')
 							{
-								objectFile << "-";
-								string tempString = "";
 								for (unsigned int j = 1; j < symbolTable[i].value.length(); j += 1)
 									tempString += symbolTable[i].value[j];
 								
-								objectFile << setfill('0') << right << setw(3) << tempString;
+								while (tempString.length() < 3)
+									tempString = "0" + tempString;
+								tempString = "-" + tempString;
 							}
 							else
 							{
-								objectFile << setfill('0') << right << setw(4) << symbolTable[i].value;
+								tempString = symbolTable[i].value;
+								while (tempString.length() < 4)
+									tempString = "0" + tempString;
 							}
 							
-							objectFile << setfill(' ') << "     ";
-							objectFile << symbolTable[i].externalName << "\n";
+							Emit(symbolTable[i].internalName, "DEC", tempString, symbolTable[i].externalName);
 							
 						}
 						else
 						{
-							objectFile << setw(4) << left << symbolTable[i].internalName;
-							objectFile << "  BSS 0001";
-							objectFile << setfill(' ') << "     ";
-							objectFile << symbolTable[i].externalName << "\n";
+							Emit(symbolTable[i].internalName, "BSS", "0001", symbolTable[i].externalName);
 						}
 					}
 				}
 			}
 			
-			objectFile << "      END STRT     \n";
+			Emit("", "END", "STRT", "");
 		
 		}
 		else if (operand1 == ";")
@@ -863,123 +1438,11 @@ void Code(string oper_ator, string operand1, string operand2)
 	
 	else if (oper_ator == "and")
 	{
-		if (operand1 == "true" || operand1 == "false")
-		{
-			if (operand1 == "true")
-			{
-				if (FindIndexOfTrue() != -1)
-				{
-					operand1 = symbolTable[FindIndexOfTrue()].externalName;
-				}
-				else
-				{
-					Insert("LOWERCASETRUE", BOOLEAN, CONSTANT, "1", YES, 1);
-					operand1 = "true";
-				}
-			}
-			else
-			{
-				if (FindIndexOfFalse() != -1)
-				{
-					operand1 = symbolTable[FindIndexOfFalse()].externalName;
-				}
-				else
-				{
-					Insert("LOWERCASEFALSE", BOOLEAN, CONSTANT, "0", YES, 1);
-					operand1 = "false";
-				}
-			}
-		}
-		
-		if (operand2 == "true" || operand2 == "false")
-		{
-			if (operand2 == "true")
-			{
-				if (FindIndexOfTrue() != -1)
-				{
-					operand2 = symbolTable[FindIndexOfTrue()].externalName;
-				}
-				else
-				{
-					Insert("LOWERCASETRUE", BOOLEAN, CONSTANT, "1", YES, 1);
-					operand2 = "true";
-				}
-			}
-			else
-			{
-				if (FindIndexOfFalse() != -1)
-				{
-					operand2 = symbolTable[FindIndexOfFalse()].externalName;
-				}
-				else
-				{
-					Insert("LOWERCASEFALSE", BOOLEAN, CONSTANT, "0", YES, 1);
-					operand2 = "false";
-				}
-			}
-		}
-		
 		EmitAndCode(operand1, operand2);
 	}
 	
 	else if (oper_ator == "or")
 	{
-		if (operand1 == "true" || operand1 == "false")
-		{
-			if (operand1 == "true")
-			{
-				if (FindIndexOfTrue() != -1)
-				{
-					operand1 = symbolTable[FindIndexOfTrue()].externalName;
-				}
-				else
-				{
-					Insert("LOWERCASETRUE", BOOLEAN, CONSTANT, "1", YES, 1);
-					operand1 = "true";
-				}
-			}
-			else
-			{
-				if (FindIndexOfFalse() != -1)
-				{
-					operand1 = symbolTable[FindIndexOfFalse()].externalName;
-				}
-				else
-				{
-					Insert("LOWERCASEFALSE", BOOLEAN, CONSTANT, "0", YES, 1);
-					operand1 = "false";
-				}
-			}
-		}
-		
-		if (operand2 == "true" || operand2 == "false")
-		{
-			if (operand2 == "true")
-			{
-				if (FindIndexOfTrue() != -1)
-				{
-					operand2 = symbolTable[FindIndexOfTrue()].externalName;
-				}
-				else
-				{
-					Insert("LOWERCASETRUE", BOOLEAN, CONSTANT, "1", YES, 1);
-					operand2 = "true";
-				}
-			}
-			else
-			{
-				if (FindIndexOfFalse() != -1)
-				{
-					operand2 = symbolTable[FindIndexOfFalse()].externalName;
-				}
-				else
-				{
-					Insert("LOWERCASEFALSE", BOOLEAN, CONSTANT, "0", YES, 1);
-					operand2 = "false";
-				}
-			}
-		}
-		
 		EmitOrCode(operand1, operand2);
 	}
 	
@@ -1015,34 +1478,6 @@ void Code(string oper_ator, string operand1, string operand2)
 	
 	else if (oper_ator == ":=")
 	{
-		if (operand1 == "true" || operand1 == "false")
-		{
-			if (operand1 == "true")
-			{
-				if (FindIndexOfTrue() != -1)
-				{
-					operand1 = symbolTable[FindIndexOfTrue()].externalName;
-				}
-				else
-				{
-					Insert("LOWERCASETRUE", BOOLEAN, CONSTANT, "1", YES, 1);
-					operand1 = "true";
-				}
-			}
-			else
-			{
-				if (FindIndexOfFalse() != -1)
-				{
-					operand1 = symbolTable[FindIndexOfFalse()].externalName;
-				}
-				else
-				{
-					Insert("LOWERCASEFALSE", BOOLEAN, CONSTANT, "0", YES, 1);
-					operand1 = "false";
-				}
-			}
-		}
-		
 		EmitAssignCode(operand1, operand2);
 	}
 	
@@ -1052,34 +1487,6 @@ void Code(string oper_ator, string operand1, string operand2)
 	
 	else if (oper_ator == "then")
 	{
-		if (operand1 == "true" || operand1 == "false")
-		{
-			if (operand1 == "true")
-			{
-				if (FindIndexOfTrue() != -1)
-				{
-					operand1 = symbolTable[FindIndexOfTrue()].externalName;
-				}
-				else
-				{
-					Insert("LOWERCASETRUE", BOOLEAN, CONSTANT, "1", YES, 1);
-					operand1 = "true";
-				}
-			}
-			else
-			{
-				if (FindIndexOfFalse() != -1)
-				{
-					operand1 = symbolTable[FindIndexOfFalse()].externalName;
-				}
-				else
-				{
-					Insert("LOWERCASEFALSE", BOOLEAN, CONSTANT, "0", YES, 1);
-					operand1 = "false";
-				}
-			}
-		}
-		
 		EmitThenCode(operand1);
 	}
 	else if (oper_ator == "else")
@@ -1096,34 +1503,6 @@ void Code(string oper_ator, string operand1, string operand2)
 	}
 	else if (oper_ator == "do")
 	{
-		if (operand1 == "true" || operand1 == "false")
-		{
-			if (operand1 == "true")
-			{
-				if (FindIndexOfTrue() != -1)
-				{
-					operand1 = symbolTable[FindIndexOfTrue()].externalName;
-				}
-				else
-				{
-					Insert("LOWERCASETRUE", BOOLEAN, CONSTANT, "1", YES, 1);
-					operand1 = "true";
-				}
-			}
-			else
-			{
-				if (FindIndexOfFalse() != -1)
-				{
-					operand1 = symbolTable[FindIndexOfFalse()].externalName;
-				}
-				else
-				{
-					Insert("LOWERCASEFALSE", BOOLEAN, CONSTANT, "0", YES, 1);
-					operand1 = "false";
-				}
-			}
-		}
-		
 		EmitDoCode(operand1);
 	}
 	else if (oper_ator == "post_while")
@@ -1136,46 +1515,196 @@ void Code(string oper_ator, string operand1, string operand2)
 	}
 	else if (oper_ator == "until")
 	{
-		if (operand1 == "true" || operand1 == "false")
+		EmitUntilCode(operand1, operand2);
+	}
+	
+	/*
+	STAGE2
+	*/
+	else
+	{		
+		Error("undefined operation");
+	}
+	
+	if (target == "c")
+		EmitCCode(oper_ator, operand1, operand2);
+	if (runProgram)
+		EmitRunCode(oper_ator, operand1, operand2);
+}
+
+// Returns the name of the boolean constant that the literal true or false
+// stands for: the first one with its value, which is entered when there is
+// none yet. Any other operand is returned as it is. Every operation sees the
+// same constant for a literal, whether or not an emitter entered TRUE or FALSE
+// before, so --check and a full compile accept the same programs.
+string MapBooleanLiteral(string operand)
+{
+	if (operand == "true")
+	{
+		if (FindIndexOfTrue() != -1)
+			return symbolTable[FindIndexOfTrue()].externalName;
+		
+		Insert("LOWERCASETRUE", BOOLEAN, CONSTANT, "1", YES, 1);
+	}
+	else if (operand == "false")
+	{
+		if (FindIndexOfFalse() != -1)
+			return symbolTable[FindIndexOfFalse()].externalName;
+		
+		Insert("LOWERCASEFALSE", BOOLEAN, CONSTANT, "0", YES, 1);
+	}
+	
+	return operand;
+}
+
+// Apply the type checks of the emitter of an operation for --check, with the
+// same messages, but emit nothing. Results are pushed as the placeholders of
+// CheckResult and labels as L0, so the operand stack grows and shrinks as it
+// does in a full compile.
+void CheckCode(string oper_ator, string operand1, string operand2)
+{
+	if (oper_ator == "program")
+	{
+		// nothing to check
+	}
+	
+	else if (oper_ator == "end")
+	{
+		if (operand1 != "." && operand1 != ";")
+			Error("illegal character follows end");
+	}
+	
+	else if (oper_ator == "read" || oper_ator == "write")
+	{
+		string currentName = "";
+		
+		operand1 += " ";
+		
+		for (unsigned int j = 0; j < operand1.length(); j += 1)
 		{
-			if (operand1 == "true")
+			if (operand1[j] == ',' || operand1[j] == ' ')
 			{
-				if (FindIndexOfTrue() != -1)
-				{
-					operand1 = symbolTable[FindIndexOfTrue()].externalName;
-				}
-				else
-				{
-					Insert("LOWERCASETRUE", BOOLEAN, CONSTANT, "1", YES, 1);
-					operand1 = "true";
-				}
+				FindIndex(currentName);
+				
+				if (oper_ator == "read" && WhichMode(currentName) != VARIABLE)
+					Error("can't change constant's value");
+				
+				currentName = "";
 			}
 			else
 			{
-				if (FindIndexOfFalse() != -1)
-				{
-					operand1 = symbolTable[FindIndexOfFalse()].externalName;
-				}
-				else
-				{
-					Insert("LOWERCASEFALSE", BOOLEAN, CONSTANT, "0", YES, 1);
-					operand1 = "false";
-				}
+				currentName = currentName + operand1[j];
 			}
 		}
+	}
+	
+	else if (oper_ator == "+" || oper_ator == "-" || oper_ator == "*" || oper_ator == "div" || oper_ator == "mod")
+	{
+		storeType type1 = CheckType(operand1);
+		storeType type2 = CheckType(operand2);
 		
-		EmitUntilCode(operand1, operand2);
+		if (type1 != INTEGER || type2 != INTEGER)
+			Error("illegal type");
+		PushOperand(CheckResult(INTEGER));
+	}
+	
+	else if (oper_ator == "neg")
+	{
+		if (CheckType(operand1) != INTEGER)
+			Error("illegal type");
+		PushOperand(CheckResult(INTEGER));
+	}
+	
+	else if (oper_ator == "not")
+	{
+		if (CheckType(operand1) != BOOLEAN)
+			Error("illegal type");
+		PushOperand(CheckResult(BOOLEAN));
+	}
+	
+	else if (oper_ator == "and" || oper_ator == "or")
+	{
+		storeType type1 = CheckType(operand1);
+		storeType type2 = CheckType(operand2);
+		
+		if (type1 != BOOLEAN || type2 != BOOLEAN)
+			Error("operator " + oper_ator + " requires boolean operands");
+		PushOperand(CheckResult(BOOLEAN));
+	}
+	
+	else if (oper_ator == "=" || oper_ator == "<>")
+	{
+		storeType type1 = CheckType(operand1);
+		storeType type2 = CheckType(operand2);
+		
+		if (type1 != type2)
+			Error("incompatible types");
+		PushOperand(CheckResult(BOOLEAN));
+	}
+	
+	else if (oper_ator == "<=" || oper_ator == ">=" || oper_ator == "<" || oper_ator == ">")
+	{
+		storeType type1 = CheckType(operand1);
+		storeType type2 = CheckType(operand2);
+		
+		if (type1 != INTEGER || type2 != INTEGER)
+			Error("illegal type");
+		PushOperand(CheckResult(BOOLEAN));
+	}
+	
+	else if (oper_ator == ":=")
+	{
+		storeType type1 = CheckType(operand1);
+		storeType type2 = CheckType(operand2);
+		
+		if (type1 != type2)
+			Error("incompatible types");
+		if (WhichMode(operand2) != VARIABLE)
+			Error("symbol on left-hand side of assignment must have a storage mode of VARIABLE");
+	}
+	
+	else if (oper_ator == "then" || oper_ator == "do" || oper_ator == "until")
+	{
+		if (CheckType(operand1) != BOOLEAN)
+			Error("predicate must be boolean valued");
+		if (oper_ator != "until")
+			PushOperand("L0");
+	}
+	
+	else if (oper_ator == "else" || oper_ator == "while" || oper_ator == "repeat")
+	{
+		PushOperand("L0");
+	}
+	
+	else if (oper_ator == "post_if" || oper_ator == "post_while")
+	{
+		// nothing to check
 	}
 	
-	/*
-	STAGE2
-	*/
 	else
-	{		
+	{
 		Error("undefined operation");
 	}
 }
 
+// Returns the data type of an operand for --check
+storeType CheckType(string operand)
+{
+	return symbolTable[FindIndex(operand)].dataType;
+}
+
+// Returns the placeholder --check pushes for a result of the type: T0 for an
+// integer and T1 for a boolean, entered once as the only temporaries
+string CheckResult(storeType type)
+{
+	string name = type == INTEGER ? "T0" : "T1";
+	
+	if (FindSymbol(name) == -1)
+		Insert(name, type, VARIABLE, "", NO, 1);
+	
+	return name;
+}
+
 // Read in value 
 void EmitReadCode(string operand1)
 {
@@ -1194,7 +1723,7 @@ void EmitReadCode(string operand1)
 			if (WhichMode(currentName) != VARIABLE)
 				Error("can't change constant's value");
 			else
-				objectFile << "      RDI " << setw(9) << left << symbolTable[index].internalName << "read(" << symbolTable[index].externalName << ")\n";
+				Emit("", "RDI", symbolTable[index].internalName, "read(" + symbolTable[index].externalName + ")");
 			
 			currentName = "";
 		}
@@ -1220,7 +1749,8 @@ void EmitWriteCode(string operand1)
 		{
 			index = FindIndex(currentName);
 			
-			objectFile << "      PRI " << symbolTable[index].internalName << "       write(" << symbolTable[index].externalName << ")\n";
+			// The write remark always follows the internal name by seven spaces
+			Emit("", "PRI", symbolTable[index].internalName, string(symbolTable[index].internalName.length() - 2, ' ') + "write(" + symbolTable[index].externalName + ")");
 			
 			currentName = "";
 		}
@@ -1244,7 +1774,7 @@ void EmitAdditionCode(string operand1, string operand2)
 		Error("illegal type");
 	if (currentARegister[0] == 'T' && currentARegister != operand1 && currentARegister != operand2)
 	{
-		objectFile << "      STA " << setw(9) << left << currentARegister << "deassign AReg\n";
+		Emit("", "STA", currentARegister, "deassign AReg");
 		indexOfTemp = FindIndex(currentARegister);
 		symbolTable[indexOfTemp].alloc = YES;
 		
@@ -1257,25 +1787,22 @@ void EmitAdditionCode(string operand1, string operand2)
 	
 	if (currentARegister == operand1)
 	{
-		objectFile << "      IAD " << setw(9) << left << symbolTable[indexOfOperand2].internalName 
-		           << symbolTable[indexOfOperand2].externalName << " + " << symbolTable[indexOfOperand1].externalName << "\n";
+		Emit("", "IAD", symbolTable[indexOfOperand2].internalName, symbolTable[indexOfOperand2].externalName + " + " + symbolTable[indexOfOperand1].externalName);
 	}
 	else if (currentARegister == operand2)
 	{
-		objectFile << "      IAD " << setw(9) << left << symbolTable[indexOfOperand1].internalName 
-		           << symbolTable[indexOfOperand2].externalName << " + " << symbolTable[indexOfOperand1].externalName << "\n";
+		Emit("", "IAD", symbolTable[indexOfOperand1].internalName, symbolTable[indexOfOperand2].externalName + " + " + symbolTable[indexOfOperand1].externalName);
 	}
 	else
 	{
-		objectFile << "      LDA " << setw(9) << left << symbolTable[indexOfOperand2].internalName << "\n";
-		objectFile << "      IAD " << setw(9) << left << symbolTable[indexOfOperand1].internalName 
-		           << symbolTable[indexOfOperand2].externalName << " + " << symbolTable[indexOfOperand1].externalName << "\n";
+		Emit("", "LDA", symbolTable[indexOfOperand2].internalName, "");
+		Emit("", "IAD", symbolTable[indexOfOperand1].internalName, symbolTable[indexOfOperand2].externalName + " + " + symbolTable[indexOfOperand1].externalName);
 	}
 	
 	
-	if (operand1[0] == 'T')
+	if (CheckForTempName(operand1))
 		FreeTemp();
-	if (operand2[0] == 'T')
+	if (CheckForTempName(operand2))
 		FreeTemp();
 	tempName = GetTemp();
 	indexOfTemp = FindIndex(tempName);
@@ -1300,7 +1827,7 @@ void EmitSubtractionCode(string operand1, string operand2)
 		
 	if (currentARegister[0] == 'T' && currentARegister != operand2)
 	{
-		objectFile << "      STA " << setw(9) << left << currentARegister << "deassign AReg\n";
+		Emit("", "STA", currentARegister, "deassign AReg");
 		indexOfTemp = FindIndex(currentARegister);
 		symbolTable[indexOfTemp].alloc = YES;
 		
@@ -1315,14 +1842,13 @@ void EmitSubtractionCode(string operand1, string operand2)
 	
 	if (currentARegister != operand2)
 	{
-		objectFile << "      LDA " << setw(9) << left << symbolTable[indexOfOperand2].internalName << "\n";
+		Emit("", "LDA", symbolTable[indexOfOperand2].internalName, "");
 	}
-	objectFile << "      ISB " << setw(9) << left << symbolTable[indexOfOperand1].internalName 
-			   << symbolTable[indexOfOperand2].externalName << " - " << symbolTable[indexOfOperand1].externalName << "\n";
+	Emit("", "ISB", symbolTable[indexOfOperand1].internalName, symbolTable[indexOfOperand2].externalName + " - " + symbolTable[indexOfOperand1].externalName);
 	
-	if (operand1[0] == 'T')
+	if (CheckForTempName(operand1))
 		FreeTemp();
-	if (operand2[0] == 'T')
+	if (CheckForTempName(operand2))
 		FreeTemp();
 	tempName = GetTemp();
 	indexOfTemp = FindIndex(tempName);
@@ -1344,7 +1870,7 @@ void EmitNegationCode(string operand1)
 		
 	if (currentARegister[0] == 'T')
 	{
-		objectFile << "      STA " << setw(9) << left << currentARegister << "deassign AReg\n";
+		Emit("", "STA", currentARegister, "deassign AReg");
 		indexOfTemp = FindIndex(currentARegister);
 		symbolTable[indexOfTemp].alloc = YES;
 		
@@ -1355,17 +1881,16 @@ void EmitNegationCode(string operand1)
 		currentARegister = "";
 	}
 	
-	objectFile << "      LDA " << setw(9) << left << "ZERO" << "\n";
+	Emit("", "LDA", "ZERO", "");
 	
 	if (!IsNameInSymbolTable("ZERO"))
 	{
 		Insert("ZERO", INTEGER, CONSTANT, "0", YES, 1);
 	}
 	
-	objectFile << "      ISB " << setw(9) << left << symbolTable[indexOfOperand1].internalName 
-			   << "-" << symbolTable[indexOfOperand1].externalName << "\n";
+	Emit("", "ISB", symbolTable[indexOfOperand1].internalName, "-" + symbolTable[indexOfOperand1].externalName);
 	
-	if (operand1[0] == 'T')
+	if (CheckForTempName(operand1))
 		FreeTemp();
 	tempName = GetTemp();
 	indexOfTemp = FindIndex(tempName);
@@ -1389,7 +1914,7 @@ void EmitDivisionCode(string operand1, string operand2)
 		
 	if (currentARegister[0] == 'T' && currentARegister != operand2)
 	{
-		objectFile << "      STA " << setw(9) << left << currentARegister << "deassign AReg\n";
+		Emit("", "STA", currentARegister, "deassign AReg");
 		indexOfTemp = FindIndex(currentARegister);
 		symbolTable[indexOfTemp].alloc = YES;
 		
@@ -1404,22 +1929,20 @@ void EmitDivisionCode(string operand1, string operand2)
 	
 	if (currentARegister == operand2)
 	{
-		objectFile << "      IDV " << setw(9) << left << symbolTable[indexOfOperand1].internalName 
-		           << symbolTable[indexOfOperand2].externalName << " div " << symbolTable[indexOfOperand1].externalName << "\n";
+		Emit("", "IDV", symbolTable[indexOfOperand1].internalName, symbolTable[indexOfOperand2].externalName + " div " + symbolTable[indexOfOperand1].externalName);
 	}
 	else
 	{
-		objectFile << "      LDA " << setw(9) << left << symbolTable[indexOfOperand2].internalName << "\n";
-		objectFile << "      IDV " << setw(9) << left << symbolTable[indexOfOperand1].internalName 
-		           << symbolTable[indexOfOperand2].externalName << " div " << symbolTable[indexOfOperand1].externalName << "\n";
+		Emit("", "LDA", symbolTable[indexOfOperand2].internalName, "");
+		Emit("", "IDV", symbolTable[indexOfOperand1].internalName, symbolTable[indexOfOperand2].externalName + " div " + symbolTable[indexOfOperand1].externalName);
 	}
 	
 	
 	
 	
-	if (operand1[0] == 'T')
+	if (CheckForTempName(operand1))
 		FreeTemp();
-	if (operand2[0] == 'T')
+	if (CheckForTempName(operand2))
 		FreeTemp();
 	
 	tempName = GetTemp();
@@ -1443,7 +1966,7 @@ void EmitModulusCode(string operand1, string operand2)
 		
 	if (currentARegister[0] == 'T' && currentARegister != operand2)
 	{
-		objectFile << "      STA " << setw(9) << left << currentARegister << "deassign AReg\n";
+		Emit("", "STA", currentARegister, "deassign AReg");
 		indexOfTemp = FindIndex(currentARegister);
 		symbolTable[indexOfTemp].alloc = YES;
 		
@@ -1458,26 +1981,23 @@ void EmitModulusCode(string operand1, string operand2)
 	
 	if (currentARegister != operand2)
 	{
-		objectFile << "      LDA " << setw(9) << left << symbolTable[indexOfOperand2].internalName << "\n";
+		Emit("", "LDA", symbolTable[indexOfOperand2].internalName, "");
 	}
 	
-	objectFile << "      IDV " << setw(9) << left << symbolTable[indexOfOperand1].internalName 
-		       << symbolTable[indexOfOperand2].externalName << " mod " << symbolTable[indexOfOperand1].externalName << "\n";
+	Emit("", "IDV", symbolTable[indexOfOperand1].internalName, symbolTable[indexOfOperand2].externalName + " mod " + symbolTable[indexOfOperand1].externalName);
 	
 	
-	if (operand1[0] == 'T')
+	if (CheckForTempName(operand1))
 		FreeTemp();
-	if (operand2[0] == 'T')
+	if (CheckForTempName(operand2))
 		FreeTemp();
 	
 	tempName = GetTemp();
 	indexOfTemp = FindIndex(tempName);
 	symbolTable[indexOfTemp].dataType = INTEGER;
 	symbolTable[indexOfTemp].alloc = YES;
-	objectFile << "      STQ " << setw(9) << left << symbolTable[indexOfTemp].internalName 
-			   << "store remainder in memory\n";
-    objectFile << "      LDA " << setw(9) << left << symbolTable[indexOfTemp].internalName 
-			   << "load remainder from memory\n";
+	Emit("", "STQ", symbolTable[indexOfTemp].internalName, "store remainder in memory");
+	Emit("", "LDA", symbolTable[indexOfTemp].internalName, "load remainder from memory");
 	currentARegister = tempName;
 	operandStk.push(tempName);
 }
@@ -1498,7 +2018,7 @@ void EmitMultiplicationCode(string operand1, string operand2)
 		
 	if (currentARegister[0] == 'T' && currentARegister != operand1 && currentARegister != operand2)
 	{
-		objectFile << "      STA " << setw(9) << left << currentARegister << "deassign AReg\n";
+		Emit("", "STA", currentARegister, "deassign AReg");
 		indexOfTemp = FindIndex(currentARegister);
 		symbolTable[indexOfTemp].alloc = YES;
 		
@@ -1513,26 +2033,23 @@ void EmitMultiplicationCode(string operand1, string operand2)
 	
 	if (currentARegister == operand1)
 	{
-		objectFile << "      IMU " << setw(9) << left << symbolTable[indexOfOperand2].internalName 
-		           << symbolTable[indexOfOperand2].externalName << " * " << symbolTable[indexOfOperand1].externalName << "\n";
+		Emit("", "IMU", symbolTable[indexOfOperand2].internalName, symbolTable[indexOfOperand2].externalName + " * " + symbolTable[indexOfOperand1].externalName);
 	}
 	else if (currentARegister == operand2)
 	{
-		objectFile << "      IMU " << setw(9) << left << symbolTable[indexOfOperand1].internalName 
-		           << symbolTable[indexOfOperand2].externalName << " * " << symbolTable[indexOfOperand1].externalName << "\n";
+		Emit("", "IMU", symbolTable[indexOfOperand1].internalName, symbolTable[indexOfOperand2].externalName + " * " + symbolTable[indexOfOperand1].externalName);
 	}
 	else
 	{
-		objectFile << "      LDA " << setw(9) << left << symbolTable[indexOfOperand2].internalName << "\n";
-		objectFile << "      IMU " << setw(9) << left << symbolTable[indexOfOperand1].internalName 
-		           << symbolTable[indexOfOperand2].externalName << " * " << symbolTable[indexOfOperand1].externalName << "\n";
+		Emit("", "LDA", symbolTable[indexOfOperand2].internalName, "");
+		Emit("", "IMU", symbolTable[indexOfOperand1].internalName, symbolTable[indexOfOperand2].externalName + " * " + symbolTable[indexOfOperand1].externalName);
 	}
 	
 	
 	
-	if (operand1[0] == 'T')
+	if (CheckForTempName(operand1))
 		FreeTemp();
-	if (operand2[0] == 'T')
+	if (CheckForTempName(operand2))
 		FreeTemp();
 	
 	tempName = GetTemp();
@@ -1547,7 +2064,7 @@ void EmitMultiplicationCode(string operand1, string operand2)
 void EmitNotCode(string operand1)
 {
 	int indexOfOperand1 = FindIndex(operand1);
-	int indexOfTemp;
+	int indexOfTemp, arithmeticCost, diamondCost;
 	string tempName, labelName;
 	
 	if (symbolTable[indexOfOperand1].dataType != BOOLEAN)
@@ -1555,7 +2072,7 @@ void EmitNotCode(string operand1)
 		
 	if (currentARegister[0] == 'T' && currentARegister != operand1)
 	{
-		objectFile << "      STA " << setw(9) << left << currentARegister << "deassign AReg\n";
+		Emit("", "STA", currentARegister, "deassign AReg");
 		indexOfTemp = FindIndex(currentARegister);
 		symbolTable[indexOfTemp].alloc = YES;
 		
@@ -1566,36 +2083,66 @@ void EmitNotCode(string operand1)
 		currentARegister = "";
 	}
 	
-	if (currentARegister != operand1)
-	{
-		objectFile << "      LDA " << setw(9) << left << symbolTable[indexOfOperand1].internalName << "\n";
-	}
-	
-	labelName = GetLabel();
-	
-	objectFile << "      AZJ " << setw(9) << left << labelName << "not " << symbolTable[indexOfOperand1].externalName << "\n";
-	
-	objectFile << "      LDA " << setw(9) << left << "FALS     \n";
+	// With a 0/1 operand, "not x" is 1 - x. That needs x in memory, while the
+	// AZJ diamond needs x in the A register.
+	arithmeticCost = InstructionCost("LDA") + InstructionCost("ISB");
+	diamondCost = InstructionCost("AZJ") + InstructionCost("LDA") + InstructionCost("UNJ");
+	if (currentARegister == operand1 && operand1[0] == 'T')
+		arithmeticCost += InstructionCost("STA");
+	else if (currentARegister != operand1)
+		diamondCost += InstructionCost("LDA");
 	
-	if (!IsNameInSymbolTable("FALSE"))
+	if (lowerBooleans && IsZeroOrOne(operand1) && arithmeticCost < diamondCost)
 	{
-		Insert("FALSE", BOOLEAN, CONSTANT, "0", YES, 1);
+		if (currentARegister == operand1 && operand1[0] == 'T')
+		{
+			Emit("", "STA", currentARegister, "deassign AReg");
+			symbolTable[indexOfOperand1].alloc = YES;
+		}
+		
+		Emit("", "LDA", "TRUE", "");
+		
+		if (!IsNameInSymbolTable("TRUE"))
+		{
+			Insert("TRUE", BOOLEAN, CONSTANT, "1", YES, 1);
+		}
+		
+		Emit("", "ISB", symbolTable[indexOfOperand1].internalName, "not " + symbolTable[indexOfOperand1].externalName);
 	}
-	
-	objectFile << "      UNJ " << setw(4) << left << labelName << "+1" << "   \n";
-	
-	objectFile << setw(6) << left << labelName << "LDA " << setw(9) << left << "TRUE     \n";
-	
-	if (!IsNameInSymbolTable("TRUE"))
+	else
 	{
-		Insert("TRUE", BOOLEAN, CONSTANT, "1", YES, 1);
-	}	
+		if (currentARegister != operand1)
+		{
+			Emit("", "LDA", symbolTable[indexOfOperand1].internalName, "");
+		}
+		
+		labelName = GetLabel();
+		
+		Emit("", "AZJ", labelName, "not " + symbolTable[indexOfOperand1].externalName);
+		
+		Emit("", "LDA", "FALS", "");
+		
+		if (!IsNameInSymbolTable("FALSE"))
+		{
+			Insert("FALSE", BOOLEAN, CONSTANT, "0", YES, 1);
+		}
+		
+		Emit("", "UNJ", labelName + "+1", "");
+		
+		Emit(labelName, "LDA", "TRUE", "");
+		
+		if (!IsNameInSymbolTable("TRUE"))
+		{
+			Insert("TRUE", BOOLEAN, CONSTANT, "1", YES, 1);
+		}	
+	}
 	
-	if (operand1[0] == 'T')
+	if (CheckForTempName(operand1))
 		FreeTemp();
 	tempName = GetTemp();
 	indexOfTemp = FindIndex(tempName);
 	symbolTable[indexOfTemp].dataType = BOOLEAN;
+	zeroOrOneTemps[currentTempNo] = true;
 	currentARegister = tempName;
 	operandStk.push(tempName);
 }
@@ -1605,16 +2152,19 @@ void EmitAndCode(string operand1, string operand2)
 {
 	int indexOfOperand1 = FindIndex(operand1);
 	int indexOfOperand2 = FindIndex(operand2);
-	int indexOfTemp;
-	string tempName;
+	int indexOfTemp, indexOfOther;
+	string tempName, labelName, remark;
+	bool zeroOrOne;
 	
 	if (symbolTable[indexOfOperand1].dataType != BOOLEAN ||
 		symbolTable[indexOfOperand2].dataType != BOOLEAN)
 		Error("operator and requires boolean operands");
+	
+	zeroOrOne = IsZeroOrOne(operand1) && IsZeroOrOne(operand2);
 		
 	if (currentARegister[0] == 'T' && currentARegister != operand1 && currentARegister != operand2)
 	{
-		objectFile << "      STA " << setw(9) << left << currentARegister << "deassign AReg\n";
+		Emit("", "STA", currentARegister, "deassign AReg");
 		indexOfTemp = FindIndex(currentARegister);
 		symbolTable[indexOfTemp].alloc = YES;
 		
@@ -1628,30 +2178,44 @@ void EmitAndCode(string operand1, string operand2)
 	
 	if (currentARegister == operand1)
 	{
-		objectFile << "      IMU " << setw(9) << left << symbolTable[indexOfOperand2].internalName 
-		           << symbolTable[indexOfOperand2].externalName << " and " << symbolTable[indexOfOperand1].externalName << "\n";
+		indexOfOther = indexOfOperand2;
 	}
 	else if (currentARegister == operand2)
 	{
-		objectFile << "      IMU " << setw(9) << left << symbolTable[indexOfOperand1].internalName 
-		           << symbolTable[indexOfOperand2].externalName << " and " << symbolTable[indexOfOperand1].externalName << "\n";
+		indexOfOther = indexOfOperand1;
+	}
+	else
+	{
+		Emit("", "LDA", symbolTable[indexOfOperand2].internalName, "");
+		indexOfOther = indexOfOperand1;
+	}
+	
+	remark = symbolTable[indexOfOperand2].externalName + " and " + symbolTable[indexOfOperand1].externalName;
+	
+	// "and" is a product. With 0/1 operands the diamond, which skips to the end
+	// when the operand in the A register is already false, gives the same value.
+	if (!lowerBooleans || !zeroOrOne || InstructionCost("IMU") <= InstructionCost("AZJ") + InstructionCost("LDA"))
+	{
+		Emit("", "IMU", symbolTable[indexOfOther].internalName, remark);
 	}
 	else
 	{
-		objectFile << "      LDA " << setw(9) << left << symbolTable[indexOfOperand2].internalName << "\n";
-		objectFile << "      IMU " << setw(9) << left << symbolTable[indexOfOperand1].internalName 
-		           << symbolTable[indexOfOperand2].externalName << " and " << symbolTable[indexOfOperand1].externalName << "\n";
+		labelName = GetLabel();
+		
+		Emit("", "AZJ", labelName + "+1", remark);
+		Emit(labelName, "LDA", symbolTable[indexOfOther].internalName, "");
 	}
 	
 	
-	if (operand1[0] == 'T')
+	if (CheckForTempName(operand1))
 		FreeTemp();
-	if (operand2[0] == 'T')
+	if (CheckForTempName(operand2))
 		FreeTemp();
 	
 	tempName = GetTemp();
 	indexOfTemp = FindIndex(tempName);
 	symbolTable[indexOfTemp].dataType = BOOLEAN;
+	zeroOrOneTemps[currentTempNo] = zeroOrOne;
 	currentARegister = tempName;
 	operandStk.push(tempName);
 }
@@ -1670,7 +2234,7 @@ void EmitOrCode(string operand1, string operand2)
 		
 	if (currentARegister[0] == 'T' && currentARegister != operand1 && currentARegister != operand2)
 	{
-		objectFile << "      STA " << setw(9) << left << currentARegister << "deassign AReg\n";
+		Emit("", "STA", currentARegister, "deassign AReg");
 		indexOfTemp = FindIndex(currentARegister);
 		symbolTable[indexOfTemp].alloc = YES;
 		
@@ -1683,40 +2247,59 @@ void EmitOrCode(string operand1, string operand2)
 	
 	if (currentARegister == operand1)
 	{
-		objectFile << "      IAD " << setw(9) << left << symbolTable[indexOfOperand2].internalName 
-		           << symbolTable[indexOfOperand2].externalName << " or " << symbolTable[indexOfOperand1].externalName << "\n";
+		Emit("", "IAD", symbolTable[indexOfOperand2].internalName, symbolTable[indexOfOperand2].externalName + " or " + symbolTable[indexOfOperand1].externalName);
 	}
 	else if (currentARegister == operand2)
 	{
-		objectFile << "      IAD " << setw(9) << left << symbolTable[indexOfOperand1].internalName 
-		           << symbolTable[indexOfOperand2].externalName << " or " << symbolTable[indexOfOperand1].externalName << "\n";
+		Emit("", "IAD", symbolTable[indexOfOperand1].internalName, symbolTable[indexOfOperand2].externalName + " or " + symbolTable[indexOfOperand1].externalName);
 	}
 	else
 	{
-		objectFile << "      LDA " << setw(9) << left << symbolTable[indexOfOperand2].internalName << "\n";
-		objectFile << "      IAD " << setw(9) << left << symbolTable[indexOfOperand1].internalName 
-		           << symbolTable[indexOfOperand2].externalName << " or " << symbolTable[indexOfOperand1].externalName << "\n";
+		Emit("", "LDA", symbolTable[indexOfOperand2].internalName, "");
+		Emit("", "IAD", symbolTable[indexOfOperand1].internalName, symbolTable[indexOfOperand2].externalName + " or " + symbolTable[indexOfOperand1].externalName);
 	}
 	
-	labelName = GetLabel();
-	
-	objectFile << "      AZJ " << setw(4) << left << labelName << "+1" << "   \n";
-	
-	objectFile << setw(6) << left << labelName << "LDA " << setw(9) << left << "TRUE     \n";
-	
-	if (!IsNameInSymbolTable("TRUE"))
+	// With 0/1 operands the sum is 0, 1 or 2, and (sum + 1) div 2 clamps it to
+	// 0 or 1 without a jump
+	if (lowerBooleans && IsZeroOrOne(operand1) && IsZeroOrOne(operand2) &&
+	    InstructionCost("IAD") + InstructionCost("IDV") < InstructionCost("AZJ") + InstructionCost("LDA"))
 	{
-		Insert("TRUE", BOOLEAN, CONSTANT, "1", YES, 1);
+		Emit("", "IAD", "TRUE", "");
+		
+		if (!IsNameInSymbolTable("TRUE"))
+		{
+			Insert("TRUE", BOOLEAN, CONSTANT, "1", YES, 1);
+		}
+		if (!IsNameInSymbolTable("2"))
+		{
+			Insert("2", INTEGER, CONSTANT, "2", YES, 1);
+		}
+		
+		Emit("", "IDV", symbolTable[FindIndex("2")].internalName, "");
+	}
+	else
+	{
+		labelName = GetLabel();
+		
+		Emit("", "AZJ", labelName + "+1", "");
+		
+		Emit(labelName, "LDA", "TRUE", "");
+		
+		if (!IsNameInSymbolTable("TRUE"))
+		{
+			Insert("TRUE", BOOLEAN, CONSTANT, "1", YES, 1);
+		}
 	}
 	
-	if (operand1[0] == 'T')
+	if (CheckForTempName(operand1))
 		FreeTemp();
-	if (operand2[0] == 'T')
+	if (CheckForTempName(operand2))
 		FreeTemp();
 	
 	tempName = GetTemp();
 	indexOfTemp = FindIndex(tempName);
 	symbolTable[indexOfTemp].dataType = BOOLEAN;
+	zeroOrOneTemps[currentTempNo] = true;
 	currentARegister = tempName;
 	operandStk.push(tempName);
 }
@@ -1734,7 +2317,7 @@ void EmitEqualsCode(string operand1, string operand2)
 		
 	if (currentARegister[0] == 'T' && currentARegister != operand1 && currentARegister != operand2)
 	{
-		objectFile << "      STA " << setw(9) << left << currentARegister << "deassign AReg\n";
+		Emit("", "STA", currentARegister, "deassign AReg");
 		indexOfTemp = FindIndex(currentARegister);
 		symbolTable[indexOfTemp].alloc = YES;
 		
@@ -1747,49 +2330,47 @@ void EmitEqualsCode(string operand1, string operand2)
 	
 	if (currentARegister == operand1)
 	{
-		objectFile << "      ISB " << setw(9) << left << symbolTable[indexOfOperand2].internalName 
-		           << symbolTable[indexOfOperand2].externalName << " = " << symbolTable[indexOfOperand1].externalName << "\n";
+		Emit("", "ISB", symbolTable[indexOfOperand2].internalName, symbolTable[indexOfOperand2].externalName + " = " + symbolTable[indexOfOperand1].externalName);
 	}
 	else if (currentARegister == operand2)
 	{
-		objectFile << "      ISB " << setw(9) << left << symbolTable[indexOfOperand1].internalName 
-		           << symbolTable[indexOfOperand2].externalName << " = " << symbolTable[indexOfOperand1].externalName << "\n";
+		Emit("", "ISB", symbolTable[indexOfOperand1].internalName, symbolTable[indexOfOperand2].externalName + " = " + symbolTable[indexOfOperand1].externalName);
 	}
 	else
 	{
-		objectFile << "      LDA " << setw(9) << left << symbolTable[indexOfOperand2].internalName << "\n";
-		objectFile << "      ISB " << setw(9) << left << symbolTable[indexOfOperand1].internalName 
-		           << symbolTable[indexOfOperand2].externalName << " = " << symbolTable[indexOfOperand1].externalName << "\n";
+		Emit("", "LDA", symbolTable[indexOfOperand2].internalName, "");
+		Emit("", "ISB", symbolTable[indexOfOperand1].internalName, symbolTable[indexOfOperand2].externalName + " = " + symbolTable[indexOfOperand1].externalName);
 	}
 	
 	labelName = GetLabel();
 	
-	objectFile << "      AZJ " << setw(4) << left << labelName << "     \n";
+	Emit("", "AZJ", labelName, "");
 	
-	objectFile << "      LDA " << setw(9) << left << "FALS     \n";
+	Emit("", "LDA", "FALS", "");
 	
 	if (!IsNameInSymbolTable("FALSE"))
 	{
 		Insert("FALSE", BOOLEAN, CONSTANT, "0", YES, 1);
 	}
 	
-	objectFile << "      UNJ " << setw(4) << left << labelName << "+1" << "   \n";
+	Emit("", "UNJ", labelName + "+1", "");
 	
-	objectFile << setw(6) << left << labelName << "LDA " << setw(9) << left << "TRUE     \n";
+	Emit(labelName, "LDA", "TRUE", "");
 	
 	if (!IsNameInSymbolTable("TRUE"))
 	{
 		Insert("TRUE", BOOLEAN, CONSTANT, "1", YES, 1);
 	}
 	
-	if (operand1[0] == 'T')
+	if (CheckForTempName(operand1))
 		FreeTemp();
-	if (operand2[0] == 'T')
+	if (CheckForTempName(operand2))
 		FreeTemp();
 	
 	tempName = GetTemp();
 	indexOfTemp = FindIndex(tempName);
 	symbolTable[indexOfTemp].dataType = BOOLEAN;
+	zeroOrOneTemps[currentTempNo] = true;
 	currentARegister = tempName;
 	operandStk.push(tempName);
 }
@@ -1807,7 +2388,7 @@ void EmitNotEqualsCode(string operand1, string operand2)
 		
 	if (currentARegister[0] == 'T' && currentARegister != operand1 && currentARegister != operand2)
 	{
-		objectFile << "      STA " << setw(9) << left << currentARegister << "deassign AReg\n";
+		Emit("", "STA", currentARegister, "deassign AReg");
 		indexOfTemp = FindIndex(currentARegister);
 		symbolTable[indexOfTemp].alloc = YES;
 		
@@ -1820,40 +2401,38 @@ void EmitNotEqualsCode(string operand1, string operand2)
 	
 	if (currentARegister == operand1)
 	{
-		objectFile << "      ISB " << setw(9) << left << symbolTable[indexOfOperand2].internalName 
-		           << symbolTable[indexOfOperand2].externalName << " <> " << symbolTable[indexOfOperand1].externalName << "\n";
+		Emit("", "ISB", symbolTable[indexOfOperand2].internalName, symbolTable[indexOfOperand2].externalName + " <> " + symbolTable[indexOfOperand1].externalName);
 	}
 	else if (currentARegister == operand2)
 	{
-		objectFile << "      ISB " << setw(9) << left << symbolTable[indexOfOperand1].internalName 
-		           << symbolTable[indexOfOperand2].externalName << " <> " << symbolTable[indexOfOperand1].externalName << "\n";
+		Emit("", "ISB", symbolTable[indexOfOperand1].internalName, symbolTable[indexOfOperand2].externalName + " <> " + symbolTable[indexOfOperand1].externalName);
 	}
 	else
 	{
-		objectFile << "      LDA " << setw(9) << left << symbolTable[indexOfOperand2].internalName << "\n";
-		objectFile << "      ISB " << setw(9) << left << symbolTable[indexOfOperand1].internalName 
-		           << symbolTable[indexOfOperand2].externalName << " <> " << symbolTable[indexOfOperand1].externalName << "\n";
+		Emit("", "LDA", symbolTable[indexOfOperand2].internalName, "");
+		Emit("", "ISB", symbolTable[indexOfOperand1].internalName, symbolTable[indexOfOperand2].externalName + " <> " + symbolTable[indexOfOperand1].externalName);
 	}
 	
 	labelName = GetLabel();
 	
-	objectFile << "      AZJ " << setw(4) << left << labelName << "+1" << "   \n";
+	Emit("", "AZJ", labelName + "+1", "");
 	
-	objectFile << setw(6) << left << labelName << "LDA " << setw(9) << left << "TRUE     \n";
+	Emit(labelName, "LDA", "TRUE", "");
 	
 	if (!IsNameInSymbolTable("TRUE"))
 	{
 		Insert("TRUE", BOOLEAN, CONSTANT, "1", YES, 1);
 	}
 	
-	if (operand1[0] == 'T')
+	if (CheckForTempName(operand1))
 		FreeTemp();
-	if (operand2[0] == 'T')
+	if (CheckForTempName(operand2))
 		FreeTemp();
 	
 	tempName = GetTemp();
 	indexOfTemp = FindIndex(tempName);
 	symbolTable[indexOfTemp].dataType = BOOLEAN;
+	zeroOrOneTemps[currentTempNo] = true;
 	currentARegister = tempName;
 	operandStk.push(tempName);
 }
@@ -1874,7 +2453,7 @@ void EmitLessThanOrEqualToCode(string operand1, string operand2)
 		
 	if (currentARegister[0] == 'T' && currentARegister != operand2)
 	{
-		objectFile << "      STA " << setw(9) << left << currentARegister << "deassign AReg\n";
+		Emit("", "STA", currentARegister, "deassign AReg");
 		indexOfTemp = FindIndex(currentARegister);
 		symbolTable[indexOfTemp].alloc = YES;
 		
@@ -1888,26 +2467,25 @@ void EmitLessThanOrEqualToCode(string operand1, string operand2)
 	
 	if (currentARegister != operand2)
 	{
-		objectFile << "      LDA " << setw(9) << left << symbolTable[indexOfOperand2].internalName << "\n";
+		Emit("", "LDA", symbolTable[indexOfOperand2].internalName, "");
 	}
-	objectFile << "      ISB " << setw(9) << left << symbolTable[indexOfOperand1].internalName 
-			   << symbolTable[indexOfOperand2].externalName << " <= " << symbolTable[indexOfOperand1].externalName << "\n";
+	Emit("", "ISB", symbolTable[indexOfOperand1].internalName, symbolTable[indexOfOperand2].externalName + " <= " + symbolTable[indexOfOperand1].externalName);
 	
 	labelName = GetLabel();
 	
-	objectFile << "      AMJ " << setw(4) << left << labelName << "     \n";
-	objectFile << "      AZJ " << setw(4) << left << labelName << "     \n";
+	Emit("", "AMJ", labelName, "");
+	Emit("", "AZJ", labelName, "");
 	
-	objectFile << "      LDA " << setw(9) << left << "FALS     \n";
+	Emit("", "LDA", "FALS", "");
 	
 	if (!IsNameInSymbolTable("FALSE"))
 	{
 		Insert("FALSE", BOOLEAN, CONSTANT, "0", YES, 1);
 	}
 	
-	objectFile << "      UNJ " << setw(4) << left << labelName << "+1" << "   \n";
+	Emit("", "UNJ", labelName + "+1", "");
 	
-	objectFile << setw(6) << left << labelName << "LDA " << setw(9) << left << "TRUE     \n";
+	Emit(labelName, "LDA", "TRUE", "");
 	
 	if (!IsNameInSymbolTable("TRUE"))
 	{
@@ -1915,13 +2493,14 @@ void EmitLessThanOrEqualToCode(string operand1, string operand2)
 	}
 	
 	
-	if (operand1[0] == 'T')
+	if (CheckForTempName(operand1))
 		FreeTemp();
-	if (operand2[0] == 'T')
+	if (CheckForTempName(operand2))
 		FreeTemp();
 	tempName = GetTemp();
 	indexOfTemp = FindIndex(tempName);
 	symbolTable[indexOfTemp].dataType = BOOLEAN;
+	zeroOrOneTemps[currentTempNo] = true;
 	currentARegister = tempName;
 	operandStk.push(tempName);
 }
@@ -1942,7 +2521,7 @@ void EmitGreaterThanOrEqualToCode(string operand2, string operand1)
 		
 	if (currentARegister[0] == 'T' && currentARegister != operand2)
 	{
-		objectFile << "      STA " << setw(9) << left << currentARegister << "deassign AReg\n";
+		Emit("", "STA", currentARegister, "deassign AReg");
 		indexOfTemp = FindIndex(currentARegister);
 		symbolTable[indexOfTemp].alloc = YES;
 		
@@ -1956,27 +2535,26 @@ void EmitGreaterThanOrEqualToCode(string operand2, string operand1)
 	
 	if (currentARegister != operand1)
 	{
-		objectFile << "      LDA " << setw(9) << left << symbolTable[indexOfOperand1].internalName << "\n";
+		Emit("", "LDA", symbolTable[indexOfOperand1].internalName, "");
 	}
-	objectFile << "      ISB " << setw(9) << left << symbolTable[indexOfOperand2].internalName 
-			   << symbolTable[indexOfOperand1].externalName << " >= " << symbolTable[indexOfOperand2].externalName << "\n";
+	Emit("", "ISB", symbolTable[indexOfOperand2].internalName, symbolTable[indexOfOperand1].externalName + " >= " + symbolTable[indexOfOperand2].externalName);
 	
 	
 	
 	labelName = GetLabel();
 	
-	objectFile << "      AMJ " << setw(4) << left << labelName << "     \n";
+	Emit("", "AMJ", labelName, "");
 	
-	objectFile << "      LDA " << setw(9) << left << "TRUE     \n";
+	Emit("", "LDA", "TRUE", "");
 	
 	if (!IsNameInSymbolTable("TRUE"))
 	{
 		Insert("TRUE", BOOLEAN, CONSTANT, "1", YES, 1);
 	}
 	
-	objectFile << "      UNJ " << setw(4) << left << labelName << "+1" << "   \n";
+	Emit("", "UNJ", labelName + "+1", "");
 	
-	objectFile << setw(6) << left << labelName << "LDA " << setw(9) << left << "FALS     \n";
+	Emit(labelName, "LDA", "FALS", "");
 	
 	if (!IsNameInSymbolTable("FALSE"))
 	{
@@ -1986,13 +2564,14 @@ void EmitGreaterThanOrEqualToCode(string operand2, string operand1)
 	
 	
 	
-	if (operand1[0] == 'T')
+	if (CheckForTempName(operand1))
 		FreeTemp();
-	if (operand2[0] == 'T')
+	if (CheckForTempName(operand2))
 		FreeTemp();
 	tempName = GetTemp();
 	indexOfTemp = FindIndex(tempName);
 	symbolTable[indexOfTemp].dataType = BOOLEAN;
+	zeroOrOneTemps[currentTempNo] = true;
 	currentARegister = tempName;
 	operandStk.push(tempName);
 }
@@ -2012,7 +2591,7 @@ void EmitLessThanCode(string operand1, string operand2)
 		
 	if (currentARegister[0] == 'T' && currentARegister != operand2)
 	{
-		objectFile << "      STA " << setw(9) << left << currentARegister << "deassign AReg\n";
+		Emit("", "STA", currentARegister, "deassign AReg");
 		indexOfTemp = FindIndex(currentARegister);
 		symbolTable[indexOfTemp].alloc = YES;
 		
@@ -2026,25 +2605,24 @@ void EmitLessThanCode(string operand1, string operand2)
 	
 	if (currentARegister != operand2)
 	{
-		objectFile << "      LDA " << setw(9) << left << symbolTable[indexOfOperand2].internalName << "\n";
+		Emit("", "LDA", symbolTable[indexOfOperand2].internalName, "");
 	}
-	objectFile << "      ISB " << setw(9) << left << symbolTable[indexOfOperand1].internalName 
-			   << symbolTable[indexOfOperand2].externalName << " < " << symbolTable[indexOfOperand1].externalName << "\n";
+	Emit("", "ISB", symbolTable[indexOfOperand1].internalName, symbolTable[indexOfOperand2].externalName + " < " + symbolTable[indexOfOperand1].externalName);
 	
 	labelName = GetLabel();
 	
-	objectFile << "      AMJ " << setw(4) << left << labelName << "     \n";
+	Emit("", "AMJ", labelName, "");
 	
-	objectFile << "      LDA " << setw(9) << left << "FALS     \n";
+	Emit("", "LDA", "FALS", "");
 	
 	if (!IsNameInSymbolTable("FALSE"))
 	{
 		Insert("FALSE", BOOLEAN, CONSTANT, "0", YES, 1);
 	}
 	
-	objectFile << "      UNJ " << setw(4) << left << labelName << "+1" << "   \n";
+	Emit("", "UNJ", labelName + "+1", "");
 	
-	objectFile << setw(6) << left << labelName << "LDA " << setw(9) << left << "TRUE     \n";
+	Emit(labelName, "LDA", "TRUE", "");
 	
 	if (!IsNameInSymbolTable("TRUE"))
 	{
@@ -2052,13 +2630,14 @@ void EmitLessThanCode(string operand1, string operand2)
 	}
 	
 	
-	if (operand1[0] == 'T')
+	if (CheckForTempName(operand1))
 		FreeTemp();
-	if (operand2[0] == 'T')
+	if (CheckForTempName(operand2))
 		FreeTemp();
 	tempName = GetTemp();
 	indexOfTemp = FindIndex(tempName);
 	symbolTable[indexOfTemp].dataType = BOOLEAN;
+	zeroOrOneTemps[currentTempNo] = true;
 	currentARegister = tempName;
 	operandStk.push(tempName);
 }
@@ -2079,7 +2658,7 @@ void EmitGreaterThanCode(string operand2, string operand1)
 		
 	if (currentARegister[0] == 'T' && currentARegister != operand2)
 	{
-		objectFile << "      STA " << setw(9) << left << currentARegister << "deassign AReg\n";
+		Emit("", "STA", currentARegister, "deassign AReg");
 		indexOfTemp = FindIndex(currentARegister);
 		symbolTable[indexOfTemp].alloc = YES;
 		
@@ -2092,39 +2671,39 @@ void EmitGreaterThanCode(string operand2, string operand1)
 	
 	if (currentARegister != operand1)
 	{
-		objectFile << "      LDA " << setw(9) << left << symbolTable[indexOfOperand1].internalName << "\n";
+		Emit("", "LDA", symbolTable[indexOfOperand1].internalName, "");
 	}
-	objectFile << "      ISB " << setw(9) << left << symbolTable[indexOfOperand2].internalName 
-			   << symbolTable[indexOfOperand1].externalName << " > " << symbolTable[indexOfOperand2].externalName << "\n";
+	Emit("", "ISB", symbolTable[indexOfOperand2].internalName, symbolTable[indexOfOperand1].externalName + " > " + symbolTable[indexOfOperand2].externalName);
 	
 	labelName = GetLabel();
 	
-	objectFile << "      AMJ " << setw(4) << left << labelName << "     \n";
-	objectFile << "      AZJ " << setw(4) << left << labelName << "     \n";
+	Emit("", "AMJ", labelName, "");
+	Emit("", "AZJ", labelName, "");
 	
-	objectFile << "      LDA " << setw(9) << left << "TRUE     \n";
+	Emit("", "LDA", "TRUE", "");
 	
 	if (!IsNameInSymbolTable("TRUE"))
 	{
 		Insert("TRUE", BOOLEAN, CONSTANT, "1", YES, 1);
 	}
 	
-	objectFile << "      UNJ " << setw(4) << left << labelName << "+1" << "   \n";
+	Emit("", "UNJ", labelName + "+1", "");
 	
-	objectFile << setw(6) << left << labelName << "LDA " << setw(9) << left << "FALS     \n";
+	Emit(labelName, "LDA", "FALS", "");
 	
 	if (!IsNameInSymbolTable("FALSE"))
 	{
 		Insert("FALSE", BOOLEAN, CONSTANT, "0", YES, 1);
 	}
 	
-	if (operand1[0] == 'T')
+	if (CheckForTempName(operand1))
 		FreeTemp();
-	if (operand2[0] == 'T')
+	if (CheckForTempName(operand2))
 		FreeTemp();
 	tempName = GetTemp();
 	indexOfTemp = FindIndex(tempName);
 	symbolTable[indexOfTemp].dataType = BOOLEAN;
+	zeroOrOneTemps[currentTempNo] = true;
 	currentARegister = tempName;
 	operandStk.push(tempName);
 }
@@ -2147,10 +2726,9 @@ void EmitAssignCode(string operand1, string operand2)
 	
 	if (symbolTable[indexOfOperand1].externalName != currentARegister)
 	{
-		objectFile << "      LDA " << setw(9) << left << symbolTable[indexOfOperand1].internalName << "\n";
+		Emit("", "LDA", symbolTable[indexOfOperand1].internalName, "");
 	}
-	objectFile << "      STA " << setw(9) << left << symbolTable[indexOfOperand2].internalName 
-			   << symbolTable[indexOfOperand2].externalName << " := " << symbolTable[indexOfOperand1].externalName << "\n";
+	Emit("", "STA", symbolTable[indexOfOperand2].internalName, symbolTable[indexOfOperand2].externalName + " := " + symbolTable[indexOfOperand1].externalName);
 	
 			   
 	currentARegister = operand2;
@@ -2174,15 +2752,15 @@ void EmitThenCode(string operand)
 		Error("predicate must be boolean valued");
 	}
 
-	if ((operand[0] != 'T' && CheckNonKeyID(operand)) || operand == "true" || operand == "false")
+	if (!CheckForTempName(operand))
 	{
-		objectFile << "      LDA " << setw(9) << left << symbolTable[indexOfOperand].internalName << "\n";
+		Emit("", "LDA", symbolTable[indexOfOperand].internalName, "");
 	}
-	objectFile << "      AZJ " << setw(4) << left << tempLabel << "     if false jump to " << tempLabel << "\n";
+	Emit("", "AZJ", tempLabel, "if false jump to " + tempLabel);
 	
 	PushOperand(tempLabel);
 	
-	if (operand[0] == 'T')
+	if (CheckForTempName(operand))
 		FreeTemp();
 		
 	currentARegister = "";
@@ -2195,9 +2773,9 @@ void EmitElseCode(string operand)
 	
 	tempLabel = GetLabel();
 	
-	objectFile << "      UNJ " << setw(4) << left << tempLabel << "     jump to end if\n";
+	Emit("", "UNJ", tempLabel, "jump to end if");
 	
-	objectFile << setw(6) << left << operand << "NOP " << setw(9) << left << "         else\n";
+	Emit(operand, "NOP", "", "else");
 	
 	PushOperand(tempLabel);
 	
@@ -2207,7 +2785,7 @@ void EmitElseCode(string operand)
 // Emit code that follows end of if statement
 void EmitPostIfCode(string operand)
 {
-	objectFile << setw(6) << left << operand << "NOP " << setw(9) << left << "         end if\n";
+	Emit(operand, "NOP", "", "end if");
 	
 	currentARegister = "";
 }
@@ -2219,7 +2797,7 @@ void EmitWhileCode()
 	
 	tempLabel = GetLabel();
 	
-	objectFile << setw(6) << left << tempLabel << "NOP " << setw(9) << left << "         while\n";
+	Emit(tempLabel, "NOP", "", "while");
 	
 	PushOperand(tempLabel);
 	
@@ -2240,15 +2818,16 @@ void EmitDoCode(string operand)
 		Error("predicate must be boolean valued");
 	}
 
-	if ((operand[0] != 'T' && CheckNonKeyID(operand)) || operand == "true" || operand == "false")
+	if (!CheckForTempName(operand))
 	{
-		objectFile << "      LDA " << setw(9) << left << symbolTable[indexOfOperand].internalName << "\n";
+		Emit("", "LDA", symbolTable[indexOfOperand].internalName, "");
 	}
-	objectFile << "      AZJ " << setw(4) << left << tempLabel << "     do\n";
+	Emit("", "AZJ", tempLabel, "do");
 	
 	PushOperand(tempLabel);
+	zeroOrOnePredicates[tempLabel] = IsZeroOrOne(operand);
 	
-	if (operand[0] == 'T')
+	if (CheckForTempName(operand))
 		FreeTemp();
 		
 	currentARegister = "";
@@ -2258,8 +2837,11 @@ void EmitDoCode(string operand)
 // operand1 is the label which should follow the end of the loop.
 void EmitPostWhileCode(string operand1, string operand2)
 {
-	objectFile << "      UNJ " << setw(4) << left << operand2 << "     end while\n";
-	objectFile << setw(6) << left << operand1 << "NOP " << setw(9) << left << "         \n";
+	if (!rotateLoops || !RotateLoop(operand1, operand2))
+	{
+		Emit("", "UNJ", operand2, "end while");
+	}
+	Emit(operand1, "NOP", "", "");
 	
 	currentARegister = "";
 }
@@ -2271,34 +2853,1927 @@ void EmitRepeatCode()
 	
 	tempLabel = GetLabel();
 	
-	objectFile << setw(6) << left << tempLabel << "NOP " << setw(9) << left << "         repeat\n";
+	Emit(tempLabel, "NOP", "", "repeat");
 	
 	PushOperand(tempLabel);
 	
 	currentARegister = "";
 }
 
-// Emit code that follows until and the predicate of loop. operand1 is the value of the
-// predicate. operand2 is the label that points to the beginning of the loop
-void EmitUntilCode(string operand1, string operand2)
+// Emit code that follows until and the predicate of loop. operand1 is the value of the
+// predicate. operand2 is the label that points to the beginning of the loop
+void EmitUntilCode(string operand1, string operand2)
+{
+	int indexOfOperand1 = FindIndex(operand1);
+	
+	if (symbolTable[indexOfOperand1].dataType != BOOLEAN)
+	{
+		Error("predicate must be boolean valued");
+	}
+	
+	if (!CheckForTempName(operand1))
+	{
+		Emit("", "LDA", symbolTable[indexOfOperand1].internalName, "");
+	}
+	Emit("", "AZJ", operand2, "until");
+	
+	if (CheckForTempName(operand1))
+		FreeTemp();
+		
+	currentARegister = "";
+}
+
+// Append an instruction to the object code
+void Emit(string label, string opcode, string operand, string remark)
+{
+	instruction newInstruction;
+	COUNT(COUNT_INSTRUCTIONS, 1);
+	
+	newInstruction.label = label;
+	newInstruction.opcode = opcode;
+	newInstruction.operand = operand;
+	newInstruction.remark = remark;
+	newInstruction.line = lineNumber;
+	
+	if (lineNumber != emitLine)
+	{
+		emitLine = lineNumber;
+		emitOrdinal = 0;
+	}
+	newInstruction.ordinal = emitOrdinal;
+	emitOrdinal += 1;
+	
+	objectCode.push_back(newInstruction);
+}
+
+// Write the object code to the object file
+void WriteObjectCode()
+{
+	TIME_SCOPE(PHASE_OUTPUT);
+	
+	PrintObjectCode(objectFile);
+	
+	objectCode.clear();
+}
+
+// Print the object code in object file format. A label with an offset, such
+// as L3+1, keeps the label in the first four columns of the operand field.
+// The label and operand fields are six and nine columns wide unless a name or
+// value needs more, as in programs with thousands of labels; then every line
+// uses the wider fields, which still leave a blank after each field.
+void PrintObjectCode(ostream &out)
+{
+	vector<stringstream> chunks;
+	vector<unsigned int> starts;
+	vector<thread> workers;
+	size_t offset;
+	unsigned int labelWidth = 6, operandWidth = 9, length;
+	
+	for (unsigned int i = 0; i < objectCode.size(); i += 1)
+	{
+		if (objectCode[i].label.length() + 1 > labelWidth)
+			labelWidth = objectCode[i].label.length() + 1;
+		offset = objectCode[i].operand.find('+', 1);
+		length = objectCode[i].operand.length();
+		if (offset != string::npos && offset < 4)
+			length += 4 - offset;
+		if (length + 1 > operandWidth)
+			operandWidth = length + 1;
+	}
+	
+	// Large object code is formatted in chunks by the jobs and written in order
+	starts = SplitObjectCode(false);
+	if (starts.size() == 2)
+	{
+		PrintObjectCodeChunk(0, objectCode.size(), labelWidth, operandWidth, out);
+		return;
+	}
+	
+	chunks.resize(starts.size() - 1);
+	for (unsigned int c = 1; c < chunks.size(); c += 1)
+		workers.push_back(thread(PrintObjectCodeChunk, starts[c], starts[c + 1], labelWidth, operandWidth,
+		                         ref(chunks[c])));
+	PrintObjectCodeChunk(starts[0], starts[1], labelWidth, operandWidth, chunks[0]);
+	for (unsigned int c = 0; c < workers.size(); c += 1)
+		workers[c].join();
+	
+	for (unsigned int c = 0; c < chunks.size(); c += 1)
+		out << chunks[c].rdbuf();
+}
+
+// Print the instructions from first up to last of the object code with the
+// given field widths
+void PrintObjectCodeChunk(unsigned int first, unsigned int last, unsigned int labelWidth,
+                          unsigned int operandWidth, ostream &out)
+{
+	string operand;
+	size_t offset;
+	
+	for (unsigned int i = first; i < last; i += 1)
+	{
+		operand = objectCode[i].operand;
+		offset = operand.find('+', 1);
+		
+		if (offset != string::npos && offset < 4)
+		{
+			operand = operand.substr(0, offset) + string(4 - offset, ' ') + operand.substr(offset);
+		}
+		
+		out << setw(labelWidth) << left << objectCode[i].label << objectCode[i].opcode << " "
+		    << setw(operandWidth) << left << operand << objectCode[i].remark << "\n";
+	}
+}
+
+// Write the source line of every word of the object code to a side table so
+// a profiler can map RAMM addresses back to source statements. Each line
+// holds an address, its source line, the order in which its instruction was
+// emitted for that line, and the hash of the line.
+void WriteLineTable(string fileName)
+{
+	ofstream lineTable(fileName.c_str());
+	unsigned int line;
+	TIME_SCOPE(PHASE_OUTPUT);
+	
+	for (unsigned int i = 0; i < objectCode.size(); i += 1)
+	{
+		line = objectCode[i].line;
+		if (objectCode[i].opcode != "END")
+			lineTable << i << " " << line << " " << objectCode[i].ordinal << " " 
+			          << (line < sourceLineHashes.size() ? sourceLineHashes[line] : 0) << "\n";
+	}
+}
+
+// Hash every line of the source, ignoring white space, so a profile can be
+// matched to the statements of an edited program
+void HashSourceLines(string fileName)
+{
+	ifstream source(fileName.c_str());
+	string line;
+	unsigned int hash;
+	
+	sourceLineHashes.assign(1, 0);
+	while (getline(source, line))
+	{
+		hash = 2166136261u;
+		for (unsigned int i = 0; i < line.length(); i += 1)
+		{
+			if (!isspace(line[i]))
+				hash = (hash ^ (unsigned char) line[i]) * 16777619u;
+		}
+		sourceLineHashes.push_back(hash);
+	}
+}
+
+// Read a profile written by ramm --profile-out. Each line holds a source line,
+// its hash, an ordinal, and how often that instruction executed and jumped;
+// anything after '#' is a comment. Every source line is matched to the
+// profiled line with the same hash nearest to it, so statements keep their
+// counts when lines are added or removed elsewhere.
+void LoadProfile(string fileName)
+{
+	ifstream profileFile(fileName.c_str());
+	map<unsigned int, vector<unsigned int> > linesWithHash;
+	profileRecord record;
+	string line;
+	unsigned int best, distance;
+	
+	if (!profileFile)
+	{
+		cerr << "cannot open profile " << fileName << "\n";
+		exit(1);
+	}
+	
+	while (getline(profileFile, line))
+	{
+		if (line.find('#') != string::npos)
+			line.erase(line.find('#'));
+		
+		istringstream fields(line);
+		if (!(fields >> record.line))
+			continue;
+		if (!(fields >> record.hash >> record.ordinal >> record.executed >> record.taken))
+		{
+			cerr << fileName << ": bad profile line: " << line << "\n";
+			exit(1);
+		}
+		
+		profileRecords[((unsigned long long) record.line << 32) | record.ordinal] = record;
+		if (profileLineCounts.find(record.line) == profileLineCounts.end())
+		{
+			profileLineCounts[record.line] = 0;
+			linesWithHash[record.hash].push_back(record.line);
+		}
+		if (record.executed > profileLineCounts[record.line])
+			profileLineCounts[record.line] = record.executed;
+	}
+	
+	for (unsigned int i = 1; i < sourceLineHashes.size(); i += 1)
+	{
+		vector<unsigned int> &candidates = linesWithHash[sourceLineHashes[i]];
+		
+		for (unsigned int j = 0; j < candidates.size(); j += 1)
+		{
+			distance = candidates[j] > i ? candidates[j] - i : i - candidates[j];
+			if (j == 0 || distance < (best > i ? best - i : i - best))
+				best = candidates[j];
+		}
+		if (!candidates.empty())
+			profileLines[i] = best;
+	}
+	
+	profileLoaded = true;
+}
+
+// Returns how often the instruction emitted ordinal-th for a source line
+// executed, or jumped when taken is true, in the profile; -1 if unknown
+long long ProfileCount(unsigned int line, unsigned int ordinal, bool taken)
+{
+	map<unsigned long long, profileRecord>::iterator record;
+	
+	if (profileLines.find(line) == profileLines.end())
+		return -1;
+	
+	record = profileRecords.find(((unsigned long long) profileLines[line] << 32) | ordinal);
+	if (record == profileRecords.end())
+		return -1;
+	
+	return taken ? record->second.taken : record->second.executed;
+}
+
+// Returns true when the profile shows a source line never executed
+bool IsColdLine(unsigned int line)
+{
+	return profileLoaded && profileLines.find(line) != profileLines.end() && 
+	       profileLineCounts[profileLines[line]] == 0;
+}
+
+// Returns the index of an opcode in the cost model, or -1 for a directive
+// such as DEC, BSS or END
+int FindOpcode(string opcode)
+{
+	for (int i = 0; i < NUMBER_OF_OPCODES; i += 1)
+	{
+		if (OPCODES[i] == opcode)
+		{
+			return i;
+		}
+	}
+	
+	return -1;
+}
+
+// Returns the estimated cost of an opcode: its cycles, or its size when
+// optimizing for size or when the profile shows the source line never ran.
+// Every optimization that chooses between code sequences asks here.
+int InstructionCost(string opcode, unsigned int line)
+{
+	int index = FindOpcode(opcode);
+	
+	if (index == -1)
+		return 0;
+	
+	if (optimizeForSize || IsColdLine(line))
+		return opcodeSize[index];
+	
+	return opcodeCycles[index];
+}
+
+// Returns the number of words an opcode occupies
+int InstructionSize(string opcode)
+{
+	int index = FindOpcode(opcode);
+	
+	if (index == -1)
+		return 0;
+	
+	return opcodeSize[index];
+}
+
+// Replace the cost model with the one in a file. Each line holds an opcode,
+// its cycles and its size in words; anything after '#' is a comment.
+void LoadCostModel(string fileName)
+{
+	ifstream costFile(fileName.c_str());
+	string line, opcode;
+	int cycles, size, index;
+	unsigned int lineCount = 0;
+	
+	if (!costFile)
+	{
+		cerr << "cannot open cost model " << fileName << "\n";
+		exit(1);
+	}
+	
+	while (getline(costFile, line))
+	{
+		lineCount += 1;
+		
+		if (line.find('#') != string::npos)
+			line = line.substr(0, line.find('#'));
+		
+		istringstream fields(line);
+		if (!(fields >> opcode))
+			continue;
+		
+		index = FindOpcode(opcode);
+		if (index == -1)
+		{
+			cerr << fileName << ":" << lineCount << ": unknown opcode " << opcode << "\n";
+			exit(1);
+		}
+		if (!(fields >> cycles >> size) || cycles < 0 || size < 0)
+		{
+			cerr << fileName << ":" << lineCount << ": expected cycles and size after " << opcode << "\n";
+			exit(1);
+		}
+		
+		opcodeCycles[index] = cycles;
+		opcodeSize[index] = size;
+	}
+}
+
+// Print the estimated static cycles and size of the object code generated for
+// each source statement, identified by its line in the listing
+void CreateCostReport(string sourceName)
+{
+	ifstream source(sourceName.c_str());
+	vector<string> lines;
+	vector<int> count, cycles, size;
+	string line;
+	int totalCount = 0, totalCycles = 0, totalSize = 0;
+	unsigned int first;
+	
+	while (getline(source, line))
+	{
+		lines.push_back(line);
+	}
+	
+	count.assign(lines.size() + 2, 0);
+	cycles.assign(lines.size() + 2, 0);
+	size.assign(lines.size() + 2, 0);
+	
+	for (unsigned int i = 0; i < objectCode.size(); i += 1)
+	{
+		if (FindOpcode(objectCode[i].opcode) != -1 && objectCode[i].line < count.size())
+		{
+			count[objectCode[i].line] += 1;
+			cycles[objectCode[i].line] += InstructionCost(objectCode[i].opcode, objectCode[i].line);
+			size[objectCode[i].line] += InstructionSize(objectCode[i].opcode);
+		}
+	}
+	
+	cout << "LINE  INSTRUCTIONS  CYCLES   SIZE  SOURCE STATEMENT\n";
+	for (unsigned int i = 0; i < count.size(); i += 1)
+	{
+		if (count[i] > 0)
+		{
+			line = (i >= 1 && i <= lines.size()) ? lines[i - 1] : "";
+			first = 0;
+			while (first < line.length() && isspace(line[first]))
+				first += 1;
+			
+			cout << right << setw(4) << i << setw(14) << count[i] << setw(8) << cycles[i]
+			     << setw(7) << size[i] << "  " << line.substr(first) << "\n";
+			
+			totalCount += count[i];
+			totalCycles += cycles[i];
+			totalSize += size[i];
+		}
+	}
+	cout << "TOTAL" << right << setw(13) << totalCount << setw(8) << totalCycles
+	     << setw(7) << totalSize << "\n";
+}
+
+// Rotate a while loop into a guarded do-while loop. The predicate stays in front
+// of the loop as a guard and is repeated at the bottom, where a single AZJ jumps
+// back to the body. Returns false if the predicate cannot be negated or the cost
+// table says rotation does not pay.
+bool RotateLoop(string exitLabel, string headLabel)
+{
+	int head, test, copyCost, loopCost;
+	unsigned int first;
+	bool invertLoads;
+	string bodyLabel, base, offset;
+	vector<string> oldLabels, newLabels;
+	instruction copy;
+	
+	// Find the loop head and the AZJ that leaves the loop
+	head = objectCode.size() - 1;
+	while (head >= 0 && objectCode[head].label != headLabel)
+	{
+		head -= 1;
+	}
+	if (head < 0)
+	{
+		return false;
+	}
+	
+	test = head + 1;
+	while (objectCode[test].opcode != "AZJ" || objectCode[test].operand != exitLabel)
+	{
+		test += 1;
+	}
+	
+	// A predicate ending in "LDA FALS; UNJ L+1; L LDA TRUE" (or the reverse) is
+	// negated by swapping the two loads. Any other predicate needs an ISB TRUE,
+	// which only negates a value known to be 0 or 1: a boolean read from input
+	// may hold any integer.
+	invertLoads = test - head > 3                             &&
+	              objectCode[test - 3].opcode == "LDA"        &&
+	              objectCode[test - 2].opcode == "UNJ"        &&
+	              objectCode[test - 1].opcode == "LDA"        &&
+	              objectCode[test - 2].operand == objectCode[test - 1].label + "+1" &&
+	              ((objectCode[test - 3].operand == "FALS" && objectCode[test - 1].operand == "TRUE") ||
+	               (objectCode[test - 3].operand == "TRUE" && objectCode[test - 1].operand == "FALS"));
+	
+	if (!invertLoads && !zeroOrOnePredicates[exitLabel])
+	{
+		return false;
+	}
+	
+	// Compare the loop control executed on each iteration
+	copyCost = InstructionCost("AZJ");
+	if (!invertLoads)
+	{
+		copyCost += InstructionCost("ISB");
+	}
+	loopCost = InstructionCost("NOP") + InstructionCost("AZJ") + InstructionCost("UNJ");
+	
+	if (copyCost >= loopCost)
+	{
+		return false;
+	}
+	
+	// The body starts right after the AZJ that leaves the loop
+	bodyLabel = GetLabel();
+	objectCode[test].label = bodyLabel;
+	
+	// Repeat the predicate, giving the labels defined inside it new names
+	first = objectCode.size();
+	for (int i = head + 1; i < test; i += 1)
+	{
+		copy = objectCode[i];
+		
+		if (copy.label != "")
+		{
+			oldLabels.push_back(copy.label);
+			newLabels.push_back(GetLabel());
+			copy.label = newLabels.back();
+		}
+		
+		objectCode.push_back(copy);
+	}
+	
+	for (unsigned int i = first; i < objectCode.size(); i += 1)
+	{
+		base = objectCode[i].operand;
+		offset = "";
+		if (base.find('+', 1) != string::npos)
+		{
+			offset = base.substr(base.find('+', 1));
+			base = base.substr(0, base.find('+', 1));
+		}
+		
+		for (unsigned int j = 0; j < oldLabels.size(); j += 1)
+		{
+			if (CheckForLabelName(base) && base == oldLabels[j])
+			{
+				objectCode[i].operand = newLabels[j] + offset;
+			}
+		}
+	}
+	
+	if (invertLoads)
+	{
+		swap(objectCode[objectCode.size() - 3].operand, objectCode[objectCode.size() - 1].operand);
+	}
+	else
+	{
+		Emit("", "ISB", "TRUE", "");
+		
+		if (!IsNameInSymbolTable("TRUE"))
+		{
+			Insert("TRUE", BOOLEAN, CONSTANT, "1", YES, 1);
+		}
+	}
+	
+	Emit("", "AZJ", bodyLabel + "+1", "end while");
+	
+	return true;
+}
+
+// Rearrange the object code over its control flow graph before it is written.
+// Jumps are threaded through NOPs and unconditional jumps, a block entered only
+// by an unconditional jump is placed right after that jump, unreachable blocks
+// are dropped, and labels nobody references are removed. With a profile the
+// blocks are chained along their hottest edges instead.
+void LayoutBlocks()
+{
+	map<string, int> labelIndex;
+	vector<int> target, blockOf, order, sequence, kept, dropped;
+	vector<block> blocks;
+	vector<bool> leader, isTarget;
+	vector<string> newLabel;
+	vector<instruction> newCode;
+	stack<int> work;
+	int codeEnd = -1, t, b, c, steps;
+	unsigned int codeSize = objectCode.size();
+	string base;
+	size_t offset;
+	
+	for (unsigned int i = 0; i < objectCode.size(); i += 1)
+	{
+		if (objectCode[i].label != "")
+			labelIndex[objectCode[i].label] = i;
+		if (objectCode[i].opcode == "HLT" && codeEnd == -1)
+			codeEnd = i;
+	}
+	if (codeEnd == -1)
+		return;
+	
+	// Resolve every jump to the index of the instruction it reaches
+	target.assign(codeEnd + 1, -1);
+	for (int i = 0; i <= codeEnd; i += 1)
+	{
+		if (CheckForJump(objectCode[i].opcode))
+		{
+			base = objectCode[i].operand;
+			offset = base.find('+', 1);
+			if (offset != string::npos)
+				base = base.substr(0, offset);
+			if (labelIndex.find(base) == labelIndex.end())
+				return;
+			
+			target[i] = labelIndex[base];
+			if (offset != string::npos)
+				target[i] += atoi(objectCode[i].operand.substr(offset + 1).c_str());
+			if (target[i] > codeEnd)
+				return;
+		}
+	}
+	
+	// Thread jumps through NOPs and through jumps to jumps
+	for (int i = 0; i <= codeEnd; i += 1)
+	{
+		if (target[i] != -1)
+		{
+			t = target[i];
+			steps = 0;
+			while (steps <= codeEnd && t > 0 && 
+			       (objectCode[t].opcode == "NOP" || objectCode[t].opcode == "UNJ"))
+			{
+				if (objectCode[t].opcode == "NOP")
+					t += 1;
+				else
+					t = target[t];
+				steps += 1;
+			}
+			target[i] = t;
+		}
+	}
+	
+	// Split the code into basic blocks
+	leader.assign(codeEnd + 2, false);
+	leader[0] = true;
+	for (int i = 0; i <= codeEnd; i += 1)
+	{
+		if (target[i] != -1)
+		{
+			leader[target[i]] = true;
+			leader[i + 1] = true;
+		}
+	}
+	
+	blockOf.assign(codeEnd + 1, -1);
+	for (int i = 0; i <= codeEnd; i += 1)
+	{
+		if (leader[i])
+		{
+			block newBlock;
+			newBlock.first = i;
+			newBlock.predecessors = 0;
+			newBlock.fallsIn = false;
+			newBlock.reachable = false;
+			newBlock.placed = false;
+			blocks.push_back(newBlock);
+		}
+		blocks.back().last = i;
+		blockOf[i] = blocks.size() - 1;
+	}
+	
+	// Mark the blocks reachable from the start of the program
+	blocks[0].reachable = true;
+	work.push(0);
+	while (!work.empty())
+	{
+		b = work.top();
+		work.pop();
+		
+		t = blocks[b].last;
+		if (target[t] != -1 && !blocks[blockOf[target[t]]].reachable)
+		{
+			blocks[blockOf[target[t]]].reachable = true;
+			work.push(blockOf[target[t]]);
+		}
+		if (objectCode[t].opcode != "UNJ" && objectCode[t].opcode != "HLT" && 
+		    !blocks[b + 1].reachable)
+		{
+			blocks[b + 1].reachable = true;
+			work.push(b + 1);
+		}
+	}
+	blocks.back().reachable = true;
+	
+	for (unsigned int i = 0; i < blocks.size(); i += 1)
+	{
+		if (blocks[i].reachable)
+		{
+			t = blocks[i].last;
+			if (target[t] != -1)
+				blocks[blockOf[target[t]]].predecessors += 1;
+			if (objectCode[t].opcode != "UNJ" && objectCode[t].opcode != "HLT")
+			{
+				blocks[i + 1].predecessors += 1;
+				blocks[i + 1].fallsIn = true;
+			}
+		}
+	}
+	
+	// Chain each block ending in UNJ with the block it jumps to whenever that
+	// jump is the only way in and the block does not fall through itself
+	if (profileLoaded)
+		ChainHotBlocks(blocks, target, blockOf, order);
+	
+	for (unsigned int i = 0; i < blocks.size(); i += 1)
+	{
+		b = i;
+		while (blocks[b].reachable && !blocks[b].placed)
+		{
+			blocks[b].placed = true;
+			order.push_back(b);
+			
+			t = blocks[b].last;
+			if (objectCode[t].opcode != "UNJ")
+				break;
+			
+			c = blockOf[target[t]];
+			if (c == 0 || c == (int) blocks.size() - 1 || blocks[c].first != target[t] ||
+			    blocks[c].predecessors != 1 || blocks[c].fallsIn ||
+			    objectCode[blocks[c].last].opcode != "UNJ")
+				break;
+			
+			b = c;
+		}
+	}
+	
+	// Drop NOPs, then drop jumps to the instruction that follows them. A block
+	// placed away from the block it falls into gets an UNJ to that block.
+	for (unsigned int i = 0; i < order.size(); i += 1)
+	{
+		b = order[i];
+		for (int j = blocks[b].first; j <= blocks[b].last; j += 1)
+		{
+			if (j == 0 || objectCode[j].opcode != "NOP")
+				sequence.push_back(j);
+		}
+		
+		t = blocks[b].last;
+		if (objectCode[t].opcode != "UNJ" && objectCode[t].opcode != "HLT" && 
+		    (i + 1 == order.size() || order[i + 1] != b + 1))
+		{
+			instruction jump = objectCode[t];
+			
+			jump.label = "";
+			jump.opcode = "UNJ";
+			jump.remark = "";
+			jump.ordinal = 0xffffffff;
+			objectCode.push_back(jump);
+			
+			t = t + 1;
+			steps = 0;
+			while (steps <= codeEnd && t > 0 && 
+			       (objectCode[t].opcode == "NOP" || objectCode[t].opcode == "UNJ"))
+			{
+				if (objectCode[t].opcode == "NOP")
+					t += 1;
+				else
+					t = target[t];
+				steps += 1;
+			}
+			target.resize(objectCode.size(), -1);
+			target.back() = t;
+			sequence.push_back(objectCode.size() - 1);
+		}
+	}
+	
+	for (unsigned int i = 0; i < sequence.size(); i += 1)
+	{
+		if (i + 1 == sequence.size() || target[sequence[i]] != sequence[i + 1])
+			kept.push_back(sequence[i]);
+	}
+	
+	// A jump to a dropped jump goes where the dropped jump went, which is the
+	// instruction after it
+	dropped.assign(objectCode.size(), -1);
+	for (int i = sequence.size() - 2; i >= 0; i -= 1)
+	{
+		if (target[sequence[i]] == sequence[i + 1])
+		{
+			dropped[sequence[i]] = sequence[i + 1];
+			if (dropped[sequence[i + 1]] != -1)
+				dropped[sequence[i]] = dropped[sequence[i + 1]];
+		}
+	}
+	for (unsigned int i = 0; i < kept.size(); i += 1)
+	{
+		if (target[kept[i]] != -1 && dropped[target[kept[i]]] != -1)
+			target[kept[i]] = dropped[target[kept[i]]];
+	}
+	
+	// Give every jump target a label, reusing labels that are already there
+	isTarget.assign(objectCode.size(), false);
+	for (unsigned int i = 0; i < kept.size(); i += 1)
+	{
+		if (target[kept[i]] != -1)
+			isTarget[target[kept[i]]] = true;
+	}
+	
+	newLabel.assign(objectCode.size(), "");
+	newLabel[0] = objectCode[0].label;
+	for (unsigned int i = 0; i < kept.size(); i += 1)
+	{
+		if (isTarget[kept[i]] && objectCode[kept[i]].label != "")
+			newLabel[kept[i]] = objectCode[kept[i]].label;
+	}
+	for (unsigned int i = 0; i < kept.size(); i += 1)
+	{
+		t = kept[i];
+		if (isTarget[t] && newLabel[t] == "")
+		{
+			if (i > 0 && kept[i - 1] == t - 1 && CheckForLabelName(newLabel[t - 1]))
+				newLabel[t] = newLabel[t - 1] + "+1";
+			else
+				newLabel[t] = GetLabel();
+		}
+	}
+	
+	for (unsigned int i = 0; i < kept.size(); i += 1)
+	{
+		instruction next = objectCode[kept[i]];
+		
+		next.label = newLabel[kept[i]].find('+') == string::npos ? newLabel[kept[i]] : "";
+		if (target[kept[i]] != -1)
+		{
+			if (next.remark == "if false jump to " + next.operand)
+				next.remark = "if false jump to " + newLabel[target[kept[i]]];
+			next.operand = newLabel[target[kept[i]]];
+		}
+		
+		newCode.push_back(next);
+	}
+	
+	for (unsigned int i = codeEnd + 1; i < codeSize; i += 1)
+	{
+		newCode.push_back(objectCode[i]);
+	}
+	
+	objectCode = newCode;
+}
+
+// Place the reachable blocks in chains along the fall-through and UNJ edges
+// the profile shows are taken most often, so the hottest jumps become fall
+// throughs. The taken edge of an AZJ or AMJ cannot fall through, as RAMM has
+// no opposite jump, and is left alone. The chain holding the first block comes
+// first and the one holding the HLT last, with never executed chains before it.
+void ChainHotBlocks(vector<block> &blocks, vector<int> &target, vector<int> &blockOf, vector<int> &order)
+{
+	vector<long long> count, weight;
+	vector<int> from, to, next, previous, heads, headOf, tailOf;
+	vector<pair<long long, int> > edges;
+	vector<bool> cold;
+	long long executed;
+	int t, c, e, tail, last = blocks.size() - 1;
+	
+	count.assign(blocks.size(), -1);
+	for (unsigned int b = 0; b < blocks.size(); b += 1)
+	{
+		for (int i = blocks[b].first; i <= blocks[b].last; i += 1)
+		{
+			executed = ProfileCount(objectCode[i].line, objectCode[i].ordinal, false);
+			if (executed > count[b])
+				count[b] = executed;
+		}
+	}
+	
+	// Weigh every edge by how often it was followed
+	for (unsigned int b = 0; b < blocks.size(); b += 1)
+	{
+		if (!blocks[b].reachable)
+			continue;
+		
+		t = blocks[b].last;
+		executed = ProfileCount(objectCode[t].line, objectCode[t].ordinal, false);
+		if (objectCode[t].opcode == "UNJ")
+		{
+			c = blockOf[target[t]];
+			if (blocks[c].first == target[t])
+			{
+				from.push_back(b);
+				to.push_back(c);
+				weight.push_back(executed);
+			}
+		}
+		else if (objectCode[t].opcode != "HLT")
+		{
+			if (CheckForJump(objectCode[t].opcode) && executed != -1)
+				executed -= ProfileCount(objectCode[t].line, objectCode[t].ordinal, true);
+			from.push_back(b);
+			to.push_back(b + 1);
+			weight.push_back(executed);
+		}
+	}
+	
+	// Join chains along the heaviest edges first; ties keep the given order
+	for (unsigned int i = 0; i < weight.size(); i += 1)
+	{
+		edges.push_back(make_pair(-weight[i], i));
+	}
+	sort(edges.begin(), edges.end());
+	
+	// Only the ends of a chain know the other end: headOf of its tail and
+	// tailOf of its head. An edge from a tail to the head of its own chain
+	// would close a cycle.
+	next.assign(blocks.size(), -1);
+	previous.assign(blocks.size(), -1);
+	headOf.resize(blocks.size());
+	tailOf.resize(blocks.size());
+	for (unsigned int b = 0; b < blocks.size(); b += 1)
+	{
+		headOf[b] = b;
+		tailOf[b] = b;
+	}
+	for (unsigned int i = 0; i < edges.size(); i += 1)
+	{
+		e = edges[i].second;
+		c = to[e];
+		if (c != 0 && next[from[e]] == -1 && previous[c] == -1 && tailOf[c] != from[e])
+		{
+			next[from[e]] = c;
+			previous[c] = from[e];
+			tail = tailOf[c];
+			tailOf[headOf[from[e]]] = tail;
+			headOf[tail] = headOf[from[e]];
+		}
+	}
+	
+	// Order the chains: the first block, the others, the cold ones, the HLT
+	cold.assign(blocks.size(), true);
+	for (unsigned int b = 0; b < blocks.size(); b += 1)
+	{
+		if (blocks[b].reachable && previous[b] == -1)
+		{
+			heads.push_back(b);
+			for (c = b; c != -1; c = next[c])
+			{
+				if (count[c] != 0)
+					cold[b] = false;
+				if (c == last)
+					cold[b] = false;
+			}
+		}
+	}
+	
+	for (int pass = 0; pass < 4; pass += 1)
+	{
+		for (unsigned int i = 0; i < heads.size(); i += 1)
+		{
+			tail = heads[i];
+			while (next[tail] != -1)
+				tail = next[tail];
+			
+			if ((pass == 0 && heads[i] == 0) ||
+			    (pass == 1 && heads[i] != 0 && tail != last && !cold[heads[i]]) ||
+			    (pass == 2 && heads[i] != 0 && tail != last && cold[heads[i]]) ||
+			    (pass == 3 && heads[i] != 0 && tail == last))
+			{
+				for (c = heads[i]; c != -1; c = next[c])
+				{
+					blocks[c].placed = true;
+					order.push_back(c);
+				}
+			}
+		}
+	}
+}
+
+// Remove redundant loads and stores and unlabeled NOPs from the object code.
+// Offsets such as L3+1 are first given labels of their own, so no instruction
+// is reached by its position and any unlabeled instruction may be removed.
+void Peephole()
+{
+	map<string, int> labelIndex;
+	vector<vector<instruction> > chunks;
+	vector<unsigned int> starts;
+	vector<thread> workers;
+	string base;
+	size_t offset;
+	int t;
+	
+	for (unsigned int i = 0; i < objectCode.size(); i += 1)
+	{
+		if (objectCode[i].label != "")
+			labelIndex[objectCode[i].label] = i;
+	}
+	
+	for (unsigned int i = 0; i < objectCode.size(); i += 1)
+	{
+		offset = objectCode[i].operand.find('+', 1);
+		if (CheckForJump(objectCode[i].opcode) && offset != string::npos)
+		{
+			base = objectCode[i].operand.substr(0, offset);
+			if (labelIndex.find(base) == labelIndex.end())
+				return;
+			
+			t = labelIndex[base] + atoi(objectCode[i].operand.substr(offset + 1).c_str());
+			if (t >= (int) objectCode.size())
+				return;
+			if (objectCode[t].label == "")
+			{
+				objectCode[t].label = GetLabel();
+				labelIndex[objectCode[t].label] = t;
+			}
+			objectCode[i].operand = objectCode[t].label;
+		}
+	}
+	
+	// Each chunk starts at a labeled instruction, which no rule removes or
+	// looks behind, so the chunks are rewritten independently
+	starts = SplitObjectCode(true);
+	chunks.resize(starts.size() - 1);
+	for (unsigned int c = 1; c < chunks.size(); c += 1)
+		workers.push_back(thread(PeepholeChunk, starts[c], starts[c + 1], ref(chunks[c])));
+	PeepholeChunk(starts[0], starts[1], chunks[0]);
+	for (unsigned int c = 0; c < workers.size(); c += 1)
+		workers[c].join();
+	
+	objectCode.clear();
+	for (unsigned int c = 0; c < chunks.size(); c += 1)
+		objectCode.insert(objectCode.end(), make_move_iterator(chunks[c].begin()),
+		                  make_move_iterator(chunks[c].end()));
+}
+
+// Rewrite the instructions from first up to last of the object code into
+// newCode for the peephole pass
+void PeepholeChunk(unsigned int first, unsigned int last, vector<instruction> &newCode)
+{
+	instruction next;
+	
+	for (unsigned int i = first; i < last; i += 1)
+	{
+		next = objectCode[i];
+		
+		if (i > 0 && next.opcode == "NOP" && next.label == "")
+			continue;
+		
+		if (next.label == "" && !newCode.empty())
+		{
+			// Loading the word just stored or loaded, or storing the word just
+			// loaded, changes nothing
+			if (next.opcode == "LDA" && next.operand == newCode.back().operand &&
+			    (newCode.back().opcode == "STA" || newCode.back().opcode == "LDA"))
+				continue;
+			if (next.opcode == "STA" && next.operand == newCode.back().operand &&
+			    newCode.back().opcode == "LDA")
+				continue;
+			
+			// A load replaced by the next load is dead
+			if (next.opcode == "LDA" && newCode.back().opcode == "LDA" && newCode.back().label == "")
+			{
+				newCode.back() = next;
+				continue;
+			}
+		}
+		
+		newCode.push_back(next);
+	}
+}
+
+// Returns where the chunks of the object code shared among the jobs start,
+// followed by the size of the object code. The chunks are about equal and at
+// least MINIMUM_CHUNK instructions long; with atLabels each one starts at a
+// labeled instruction, such as the NOP that ends an if or begins a loop.
+vector<unsigned int> SplitObjectCode(bool atLabels)
+{
+	vector<unsigned int> starts(1, 0);
+	unsigned int size = objectCode.size(), chunks = size / MINIMUM_CHUNK, start;
+	
+	if (chunks > jobs)
+		chunks = jobs;
+	
+	for (unsigned int c = 1; c < chunks; c += 1)
+	{
+		start = (unsigned long long) size * c / chunks;
+		if (start <= starts.back())
+			start = starts.back() + 1;
+		while (atLabels && start < size && objectCode[start].label == "")
+			start += 1;
+		if (start < size)
+			starts.push_back(start);
+	}
+	starts.push_back(size);
+	
+	return starts;
+}
+
+// Set the passes run by an optimization level: -O0 runs none and keeps the
+// object code exactly as the emitters write it, -O1 and -O2 optimize for
+// speed, and -Os chooses between code sequences by size.
+bool SetOptimizationLevel(string level)
+{
+	passPipeline.clear();
+	optimizeForSize = false;
+	
+	if (level == "-O0")
+	{
+		// no passes
+	}
+	else if (level == "-O1")
+	{
+		passPipeline = SplitList("rotate-loops,lower-booleans,peephole,layout-blocks");
+	}
+	else if (level == "-O2")
+	{
+		passPipeline = SplitList("rotate-loops,lower-booleans,peephole,layout-blocks,peephole");
+	}
+	else if (level == "-Os")
+	{
+		passPipeline = SplitList("lower-booleans,peephole,layout-blocks");
+		optimizeForSize = true;
+	}
+	else
+	{
+		return false;
+	}
+	
+	return true;
+}
+
+bool CheckForPassName(string name)
+{
+	for (int i = 0; i < NUMBER_OF_PASSES; i += 1)
+	{
+		if (PASS_NAMES[i] == name)
+			return true;
+	}
+	
+	return false;
+}
+
+// A pass is enabled if it is in the pipeline and was not disabled
+bool IsPassEnabled(string name)
+{
+	return IsNameInList(name, passPipeline) && !IsNameInList(name, disabledPasses);
+}
+
+bool IsNameInList(string name, const vector<string> &list)
+{
+	for (unsigned int i = 0; i < list.size(); i += 1)
+	{
+		if (list[i] == name)
+			return true;
+	}
+	
+	return false;
+}
+
+// Split a comma separated list
+vector<string> SplitList(string list)
+{
+	vector<string> names;
+	string currentName = "";
+	
+	list += ",";
+	
+	for (unsigned int j = 0; j < list.length(); j += 1)
+	{
+		if (list[j] == ',')
+		{
+			if (currentName != "")
+				names.push_back(currentName);
+			currentName = "";
+		}
+		else
+		{
+			currentName = currentName + list[j];
+		}
+	}
+	
+	return names;
+}
+
+// Run the object code passes of the pipeline in order. Emitter passes have
+// already done their work while parsing, so they are only printed after.
+void RunPasses()
+{
+	chrono::steady_clock::time_point start;
+	string name;
+	TIME_SCOPE(PHASE_OPTIMIZE);
+	
+	for (unsigned int i = 0; i < passPipeline.size(); i += 1)
+	{
+		name = passPipeline[i];
+		if (IsNameInList(name, disabledPasses))
+			continue;
+		
+		start = chrono::steady_clock::now();
+		
+		if (name == "peephole")
+		{
+			Peephole();
+			RecordPhase(name, start);
+		}
+		else if (name == "layout-blocks")
+		{
+			LayoutBlocks();
+			RecordPhase(name, start);
+		}
+		
+		if (IsNameInList(name, printAfterPasses))
+		{
+			cerr << "*** object code after " << name << " ***\n";
+			PrintObjectCode(cerr);
+		}
+	}
+}
+
+// Record the time spent in a phase that began at start
+void RecordPhase(string name, chrono::steady_clock::time_point start)
+{
+	chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+	
+	phaseNames.push_back(name);
+	phaseSeconds.push_back(elapsed.count());
+}
+
+// Print the time spent in parsing and in each object code pass
+void CreatePassTimeReport()
+{
+	double total = 0;
+	
+	cerr << "PASS                 SECONDS\n";
+	for (unsigned int i = 0; i < phaseNames.size(); i += 1)
+	{
+		cerr << setw(16) << left << phaseNames[i] << right << setw(12) << fixed 
+		     << setprecision(6) << phaseSeconds[i] << "\n";
+		total += phaseSeconds[i];
+	}
+	cerr << setw(16) << left << "total" << right << setw(12) << fixed 
+	     << setprecision(6) << total << "\n";
+	if (firstOutputSeconds >= 0)
+		cerr << setw(16) << left << "first output" << right << setw(12) << fixed 
+		     << setprecision(6) << firstOutputSeconds << "\n";
+}
+
+#ifdef TIME_REPORT
+// Charge the time since the last switch to the running phase and run phase
+reportScope::reportScope(reportPhases phase)
+{
+	chrono::steady_clock::time_point now = chrono::steady_clock::now();
+	
+	reportSeconds[reportPhase] += chrono::duration<double>(now - reportSwitch).count();
+	reportSwitch = now;
+	interrupted = reportPhase;
+	reportPhase = phase;
+}
+
+// Charge the time since the last switch to the phase ending and go back to
+// the phase it interrupted
+reportScope::~reportScope()
+{
+	chrono::steady_clock::time_point now = chrono::steady_clock::now();
+	
+	reportSeconds[reportPhase] += chrono::duration<double>(now - reportSwitch).count();
+	reportSwitch = now;
+	reportPhase = interrupted;
+}
+#endif
+
+// Print the time spent in each phase and the counters, as a table or as JSON
+void CreateTimeReport()
+{
+#ifdef TIME_REPORT
+	double total = 0;
+	
+	reportSeconds[reportPhase] += chrono::duration<double>(chrono::steady_clock::now() - reportSwitch).count();
+	reportSwitch = chrono::steady_clock::now();
+	for (int i = 0; i < NUMBER_OF_REPORT_PHASES; i += 1)
+	{
+		total += reportSeconds[i];
+	}
+	
+	if (timeReport == "json")
+	{
+		cerr << "{\"phases\": {";
+		for (int i = 0; i < NUMBER_OF_REPORT_PHASES; i += 1)
+		{
+			cerr << (i > 0 ? ", " : "") << "\"" << REPORT_PHASE_NAMES[i] << "\": " 
+			     << fixed << setprecision(6) << reportSeconds[i];
+		}
+		cerr << ", \"total\": " << total << "}, \"counters\": {";
+		for (int i = 0; i < NUMBER_OF_COUNTERS; i += 1)
+		{
+			cerr << (i > 0 ? ", " : "") << "\"" << COUNTER_NAMES[i] << "\": " << reportCounts[i];
+		}
+		cerr << "}}\n";
+		return;
+	}
+	
+	cerr << "PHASE                SECONDS       %\n";
+	for (int i = 0; i < NUMBER_OF_REPORT_PHASES; i += 1)
+	{
+		cerr << setw(16) << left << REPORT_PHASE_NAMES[i] << right << setw(12) << fixed 
+		     << setprecision(6) << reportSeconds[i] << setw(8) << setprecision(1) 
+		     << (total > 0 ? 100 * reportSeconds[i] / total : 0) << "\n";
+	}
+	cerr << setw(16) << left << "total" << right << setw(12) << fixed 
+	     << setprecision(6) << total << "\n\n";
+	
+	cerr << "COUNTER                COUNT\n";
+	for (int i = 0; i < NUMBER_OF_COUNTERS; i += 1)
+	{
+		cerr << setw(16) << left << COUNTER_NAMES[i] << right << setw(12) << reportCounts[i] << "\n";
+	}
+#endif
+}
+
+// Write the object code as x86-64 GNU assembly for Linux. A lives in rax and
+// Q in rdx. Constants become immediates, and the most used variables and
+// temporaries live in registers instead of memory. Read and write call a
+// small runtime at the end of the file that keeps every register but rdi.
+void WriteAssemblyCode()
+{
+	const int NUMBER_OF_REGISTERS = 10;
+	const string REGISTERS[NUMBER_OF_REGISTERS] = 
+		{"%rbx", "%rbp", "%r12", "%r13", "%r14", "%r15", "%r8", "%r9", "%r10", "%r11"};
+	map<string, int> labelIndex, uses;
+	map<string, long long> value;
+	map<string, bool> stored;
+	map<string, string> location;
+	map<string, int>::iterator it;
+	vector<int> target;
+	vector<bool> isTarget;
+	vector<string> inRegisters;
+	string base, cell, operand, opcode, best;
+	size_t offset;
+	int codeEnd = -1;
+	long long divisor;
+	TIME_SCOPE(PHASE_OUTPUT);
+	
+	for (unsigned int i = 0; i < objectCode.size(); i += 1)
+	{
+		if (objectCode[i].label != "")
+			labelIndex[objectCode[i].label] = i;
+		if (objectCode[i].opcode == "HLT" && codeEnd == -1)
+			codeEnd = i;
+		if (objectCode[i].opcode == "DEC")
+			value[objectCode[i].label] = atoll(objectCode[i].operand.c_str());
+		if (objectCode[i].opcode == "BSS")
+			value[objectCode[i].label] = 0;
+	}
+	if (codeEnd == -1)
+		return;
+	
+	// Resolve jumps and count the uses of every cell
+	target.assign(codeEnd + 1, -1);
+	isTarget.assign(codeEnd + 1, false);
+	for (int i = 0; i <= codeEnd; i += 1)
+	{
+		if (CheckForJump(objectCode[i].opcode))
+		{
+			base = objectCode[i].operand;
+			offset = base.find('+', 1);
+			if (offset != string::npos)
+				base = base.substr(0, offset);
+			if (labelIndex.find(base) != labelIndex.end())
+			{
+				target[i] = labelIndex[base];
+				if (offset != string::npos)
+					target[i] += atoi(objectCode[i].operand.substr(offset + 1).c_str());
+			}
+			if (target[i] < 0 || target[i] > codeEnd)
+			{
+				// Every jump of the object code has a target, so this is a
+				// bug of the compiler, not of the program
+				errorCount += 1;
+				listingFile << "\nError: compiler error, jump to undefined label " 
+				            << objectCode[i].operand << "\n";
+				cerr << "Error: compiler error, jump to undefined label " << objectCode[i].operand << "\n";
+				CreateListingTrailer();
+				exit(1);
+			}
+			isTarget[target[i]] = true;
+		}
+		else if (objectCode[i].operand != "")
+		{
+			uses[objectCode[i].operand] += 1;
+			if (objectCode[i].opcode == "STA" || objectCode[i].opcode == "STQ" || 
+			    objectCode[i].opcode == "RDI")
+				stored[objectCode[i].operand] = true;
+		}
+	}
+	
+	// Constants that are never stored become immediates
+	for (it = uses.begin(); it != uses.end(); ++it)
+	{
+		cell = it->first;
+		if (!stored[cell] && value.find(cell) != value.end() && 
+		    value[cell] >= -2147483647LL && value[cell] <= 2147483647LL)
+		{
+			location[cell] = "$" + to_string(value[cell]);
+		}
+	}
+	
+	// Give the registers to the most used of the other cells
+	for (int r = 0; r < NUMBER_OF_REGISTERS; r += 1)
+	{
+		best = "";
+		for (it = uses.begin(); it != uses.end(); ++it)
+		{
+			if (location.find(it->first) == location.end() && 
+			    (best == "" || it->second > uses[best]))
+				best = it->first;
+		}
+		if (best == "")
+			break;
+		location[best] = REGISTERS[r];
+		inRegisters.push_back(best);
+	}
+	for (it = uses.begin(); it != uses.end(); ++it)
+	{
+		if (location.find(it->first) == location.end())
+			location[it->first] = "v_" + it->first + "(%rip)";
+	}
+	
+	objectFile << "# " << symbolTable[0].externalName << " - BRIAN LEARY, JOSEPH LYNCH\n"
+	           << "\t.text\n\t.globl main\nmain:\n"
+	           << "\tpushq %rbx\n\tpushq %rbp\n\tpushq %r12\n\tpushq %r13\n\tpushq %r14\n\tpushq %r15\n"
+	           << "\tsubq $8, %rsp\n";
+	for (unsigned int i = 0; i < inRegisters.size(); i += 1)
+	{
+		objectFile << "\tmovabsq $" << value[inRegisters[i]] << ", " 
+		           << location[inRegisters[i]] << "\t# " << inRegisters[i] << "\n";
+	}
+	
+	for (int i = 0; i <= codeEnd; i += 1)
+	{
+		opcode = objectCode[i].opcode;
+		operand = (objectCode[i].operand != "" && location.find(objectCode[i].operand) != location.end()) 
+		          ? location[objectCode[i].operand] : "";
+		
+		if (isTarget[i])
+			objectFile << ".L" << i << ":\n";
+		if (objectCode[i].remark != "" && i > 0)
+			objectFile << "\t# " << objectCode[i].remark << "\n";
+		
+		if (opcode == "LDA")
+			objectFile << "\tmovq " << operand << ", %rax\n";
+		else if (opcode == "STA")
+			objectFile << "\tmovq %rax, " << operand << "\n";
+		else if (opcode == "IAD")
+			objectFile << "\taddq " << operand << ", %rax\n";
+		else if (opcode == "ISB")
+			objectFile << "\tsubq " << operand << ", %rax\n";
+		else if (opcode == "IMU")
+			objectFile << "\timulq " << operand << ", %rax\n";
+		else if (opcode == "IDV")
+		{
+			// A divisor of -1 negates A, so the smallest integer does not trap
+			if (operand[0] == '$')
+			{
+				divisor = atoll(operand.substr(1).c_str());
+				if (divisor == 0)
+					objectFile << "\tjmp pl_divide_error\n";
+				else if (divisor == -1)
+					objectFile << "\tnegq %rax\n\txorl %edx, %edx\n";
+				else
+					objectFile << "\tmovq " << operand << ", %rcx\n\tcqto\n\tidivq %rcx\n";
+			}
+			else
+			{
+				objectFile << "\tmovq " << operand << ", %rcx\n"
+				           << "\ttestq %rcx, %rcx\n\tjz pl_divide_error\n"
+				           << "\tcmpq $-1, %rcx\n\tjne .D" << i << "\n"
+				           << "\tnegq %rax\n\txorl %edx, %edx\n\tjmp .E" << i << "\n"
+				           << ".D" << i << ":\n\tcqto\n\tidivq %rcx\n"
+				           << ".E" << i << ":\n";
+			}
+		}
+		else if (opcode == "STQ")
+			objectFile << "\tmovq %rdx, " << operand << "\n";
+		else if (opcode == "AZJ" || opcode == "AMJ" || opcode == "UNJ")
+		{
+			if (opcode != "UNJ")
+				objectFile << "\ttestq %rax, %rax\n" << (opcode == "AZJ" ? "\tjz " : "\tjs ");
+			else
+				objectFile << "\tjmp ";
+			
+			objectFile << ".L" << target[i] << "\n";
+		}
+		else if (opcode == "RDI")
+			objectFile << "\tcall pl_read\n\tmovq %rdi, " << operand << "\n";
+		else if (opcode == "PRI")
+			objectFile << "\tmovq " << operand << ", %rdi\n\tcall pl_write\n";
+	}
+	
+	// The runtime: halt, read and write through stdio, and runtime errors
+	objectFile << "pl_halt:\n\taddq $8, %rsp\n"
+	           << "\tpopq %r15\n\tpopq %r14\n\tpopq %r13\n\tpopq %r12\n\tpopq %rbp\n\tpopq %rbx\n"
+	           << "\txorl %eax, %eax\n\tret\n"
+	           << "pl_read:\n"
+	           << "\tpushq %rax\n\tpushq %rcx\n\tpushq %rdx\n\tpushq %rsi\n"
+	           << "\tpushq %r8\n\tpushq %r9\n\tpushq %r10\n\tpushq %r11\n\tsubq $8, %rsp\n"
+	           << "\tmovq %rsp, %rsi\n\tleaq pl_read_format(%rip), %rdi\n\txorl %eax, %eax\n"
+	           << "\tcall scanf@PLT\n\tcmpl $1, %eax\n\tjne pl_input_error\n\tmovq (%rsp), %rdi\n"
+	           << "\taddq $8, %rsp\n\tpopq %r11\n\tpopq %r10\n\tpopq %r9\n\tpopq %r8\n"
+	           << "\tpopq %rsi\n\tpopq %rdx\n\tpopq %rcx\n\tpopq %rax\n\tret\n"
+	           << "pl_write:\n"
+	           << "\tpushq %rax\n\tpushq %rcx\n\tpushq %rdx\n\tpushq %rsi\n"
+	           << "\tpushq %r8\n\tpushq %r9\n\tpushq %r10\n\tpushq %r11\n\tsubq $8, %rsp\n"
+	           << "\tmovq %rdi, %rsi\n\tleaq pl_write_format(%rip), %rdi\n\txorl %eax, %eax\n"
+	           << "\tcall printf@PLT\n"
+	           << "\taddq $8, %rsp\n\tpopq %r11\n\tpopq %r10\n\tpopq %r9\n\tpopq %r8\n"
+	           << "\tpopq %rsi\n\tpopq %rdx\n\tpopq %rcx\n\tpopq %rax\n\tret\n"
+	           << "pl_input_error:\n\tleaq pl_input_message(%rip), %rdi\n\tjmp pl_fail\n"
+	           << "pl_divide_error:\n\tleaq pl_divide_message(%rip), %rdi\n"
+	           << "pl_fail:\n\tandq $-16, %rsp\n\tmovq stderr@GOTPCREL(%rip), %rsi\n\tmovq (%rsi), %rsi\n"
+	           << "\tcall fputs@PLT\n\tmovl $2, %edi\n\tcall exit@PLT\n"
+	           << "\t.section .rodata\n"
+	           << "pl_read_format:\n\t.string \"%lld\"\n"
+	           << "pl_write_format:\n\t.string \"%lld\\n\"\n"
+	           << "pl_input_message:\n\t.string \"input exhausted or not an integer\\n\"\n"
+	           << "pl_divide_message:\n\t.string \"division by zero\\n\"\n"
+	           << "\t.data\n\t.balign 8\n";
+	for (it = uses.begin(); it != uses.end(); ++it)
+	{
+		if (location[it->first][0] == 'v')
+			objectFile << "v_" << it->first << ":\n\t.quad " << value[it->first] << "\n";
+	}
+	objectFile << "\t.section .note.GNU-stack,\"\",@progbits\n";
+	
+	objectCode.clear();
+}
+
+// Translate an operation of Code() into C for --target=c. The RAMM emitters
+// have already checked it and pushed its result, so the C expression of the
+// result is kept for the temporary on top of the operand stack. Temporaries
+// are used exactly once, which lets expressions nest instead of going
+// through temporaries; only statements are written out.
+void EmitCCode(string oper_ator, string operand1, string operand2)
+{
+	string left, right, name;
+	
+	if (oper_ator == "+" || oper_ator == "-" || oper_ator == "*" || oper_ator == "and" ||
+	    oper_ator == "or" || oper_ator == "=" || oper_ator == "<>" || oper_ator == "<" ||
+	    oper_ator == "<=" || oper_ator == ">" || oper_ator == ">=")
+	{
+		right = CExpression(operand1);
+		left = CExpression(operand2);
+		
+		// and and or compute what the RAMM code does, also on booleans read
+		// as other values than 0 and 1: the product, and whether the sum is
+		// not zero
+		if (oper_ator == "and")
+			cExpressions[operandStk.top()] = "(" + left + " * " + right + ")";
+		else if (oper_ator == "or")
+			cExpressions[operandStk.top()] = "((" + left + " + " + right + ") != 0)";
+		else if (oper_ator == "=")
+			cExpressions[operandStk.top()] = "(" + left + " == " + right + ")";
+		else if (oper_ator == "<>")
+			cExpressions[operandStk.top()] = "(" + left + " != " + right + ")";
+		else
+			cExpressions[operandStk.top()] = "(" + left + " " + oper_ator + " " + right + ")";
+	}
+	else if (oper_ator == "div" || oper_ator == "mod")
+	{
+		right = CExpression(operand1);
+		left = CExpression(operand2);
+		cExpressions[operandStk.top()] = (oper_ator == "div" ? "Divide(" : "Modulus(") + 
+		                                 StripParentheses(left) + ", " + StripParentheses(right) + ")";
+	}
+	else if (oper_ator == "neg")
+	{
+		right = CExpression(operand1);
+		cExpressions[operandStk.top()] = "(-" + right + ")";
+	}
+	else if (oper_ator == "not")
+	{
+		right = CExpression(operand1);
+		cExpressions[operandStk.top()] = "(!" + right + ")";
+	}
+	else if (oper_ator == ":=")
+	{
+		right = CExpression(operand1);
+		CStatement(CName(operand2) + " = " + StripParentheses(right) + ";");
+	}
+	else if (oper_ator == "read" || oper_ator == "write")
+	{
+		operand1 += ",";
+		for (unsigned int j = 0; j < operand1.length(); j += 1)
+		{
+			if (operand1[j] == ',')
+			{
+				if (oper_ator == "read")
+					CStatement(CName(name) + " = ReadInteger();");
+				else
+					CStatement("WriteInteger(" + CExpression(name) + ");");
+				name = "";
+			}
+			else if (operand1[j] != ' ')
+			{
+				name += operand1[j];
+			}
+		}
+	}
+	else if (oper_ator == "then")
+	{
+		CStatement("if (" + StripParentheses(CExpression(operand1)) + ")");
+		CStatement("{");
+		cIndent += 1;
+	}
+	else if (oper_ator == "else")
+	{
+		cIndent -= 1;
+		CStatement("}");
+		CStatement("else");
+		CStatement("{");
+		cIndent += 1;
+	}
+	else if (oper_ator == "post_if" || oper_ator == "post_while")
+	{
+		cIndent -= 1;
+		CStatement("}");
+	}
+	else if (oper_ator == "do")
+	{
+		CStatement("while (" + StripParentheses(CExpression(operand1)) + ")");
+		CStatement("{");
+		cIndent += 1;
+	}
+	else if (oper_ator == "repeat")
+	{
+		CStatement("do");
+		CStatement("{");
+		cIndent += 1;
+	}
+	else if (oper_ator == "until")
+	{
+		right = CExpression(operand1);
+		cIndent -= 1;
+		CStatement("} while (!" + right + ");");
+	}
+}
+
+// Returns the C expression for an operand: the expression saved for a
+// temporary, the value of a literal, or the name of a variable or constant
+string CExpression(string name)
+{
+	string expression;
+	int index;
+	
+	if (cExpressions.find(name) != cExpressions.end())
+	{
+		expression = cExpressions[name];
+		cExpressions.erase(name);
+		return expression;
+	}
+	
+	index = FindIndex(name);
+	if (symbolTable[index].mode == CONSTANT && !CheckNonKeyID(name))
+	{
+		if (symbolTable[index].value[0] == '-')
+			return "(" + symbolTable[index].value + ")";
+		return symbolTable[index].value;
+	}
+	
+	return CName(name);
+}
+
+// Returns the C name of a Pascallite name. Every name gets the prefix v_, so
+// no name can be a C keyword or hide a name of the library or the runtime.
+string CName(string name)
+{
+	return "v_" + name;
+}
+
+// Remove the parentheses around a whole expression
+string StripParentheses(string expression)
+{
+	int depth = 0;
+	
+	if (expression.length() < 2 || expression[0] != '(' || expression[expression.length() - 1] != ')')
+		return expression;
+	
+	for (unsigned int i = 0; i < expression.length() - 1; i += 1)
+	{
+		if (expression[i] == '(')
+			depth += 1;
+		else if (expression[i] == ')')
+			depth -= 1;
+		if (depth == 0)
+			return expression;
+	}
+	
+	return expression.substr(1, expression.length() - 2);
+}
+
+// Append a statement of the C program at the current indentation
+void CStatement(string statement)
+{
+	cStatements.push_back(string(cIndent, '\t') + statement);
+}
+
+// Write the C program: a small runtime, then main with a typed local for
+// every variable and constant of the symbol table and the statements
+void WriteCCode()
+{
+	string type;
+	TIME_SCOPE(PHASE_OUTPUT);
+	
+	objectFile << "/* " << symbolTable[0].externalName << " - BRIAN LEARY, JOSEPH LYNCH */\n"
+	           << "#include <stdio.h>\n#include <stdlib.h>\n\n"
+	           << "static char outputBuffer[1 << 16];\n\n"
+	           << "static inline long long ReadInteger(void)\n{\n\tlong long value;\n\n"
+	           << "\tif (scanf(\"%lld\", &value) != 1)\n\t{\n"
+	           << "\t\tfputs(\"input exhausted or not an integer\\n\", stderr);\n\t\texit(2);\n\t}\n"
+	           << "\treturn value;\n}\n\n"
+	           << "static inline void WriteInteger(long long value)\n{\n"
+	           << "\tprintf(\"%lld\\n\", value);\n}\n\n"
+	           << "static inline void CheckDivisor(long long divisor)\n{\n"
+	           << "\tif (divisor == 0)\n\t{\n\t\tfputs(\"division by zero\\n\", stderr);\n\t\texit(2);\n\t}\n}\n\n"
+	           << "/* A divisor of -1 negates, so the smallest integer does not trap */\n"
+	           << "static inline long long Divide(long long dividend, long long divisor)\n{\n"
+	           << "\tCheckDivisor(divisor);\n"
+	           << "\treturn divisor == -1 ? (long long) (0 - (unsigned long long) dividend) : dividend / divisor;\n}\n\n"
+	           << "static inline long long Modulus(long long dividend, long long divisor)\n{\n"
+	           << "\tCheckDivisor(divisor);\n"
+	           << "\treturn divisor == -1 ? 0 : dividend % divisor;\n}\n\n"
+	           << "int main(void)\n{\n";
+	
+	for (unsigned int i = 1; i < symbolTable.size() && symbolTable[i].externalName != ""; i += 1)
+	{
+		if (!CheckNonKeyID(symbolTable[i].externalName))
+			continue;
+		
+		type = (symbolTable[i].dataType == BOOLEAN) ? "int" : "long long";
+		if (symbolTable[i].mode == CONSTANT)
+			objectFile << "\tconst " << type << " " << CName(symbolTable[i].externalName) 
+			           << " = " << symbolTable[i].value << ";\n";
+		else
+			objectFile << "\t" << type << " " << CName(symbolTable[i].externalName) << " = 0;\n";
+	}
+	
+	objectFile << "\n\tsetvbuf(stdout, outputBuffer, _IOFBF, sizeof outputBuffer);\n\n";
+	for (unsigned int i = 0; i < cStatements.size(); i += 1)
+		objectFile << cStatements[i] << "\n";
+	objectFile << "\treturn 0;\n}\n";
+	
+	cStatements.clear();
+}
+
+// Translate an operation of Code() into the bytecode run by --run. As for
+// the C target, the RAMM emitters have already checked the operation and
+// pushed its result. Every operand is resolved to its slot, the index of its
+// symbol table entry, so running the program never looks up a name. Jumps
+// are patched through the labels the emitters push for if, while and repeat.
+void EmitRunCode(string oper_ator, string operand1, string operand2)
+{
+	const int NUMBER_OF_OPERATORS = 15;
+	const string OPERATORS[NUMBER_OF_OPERATORS] = 
+		{"+", "-", "*", "div", "mod", "and", "or", "=", "<>", "<", "<=", ">", ">=", "neg", "not"};
+	const runOpcodes OPCODES[NUMBER_OF_OPERATORS] = 
+		{RUN_ADD, RUN_SUB, RUN_MUL, RUN_DIV, RUN_MOD, RUN_AND, RUN_OR, RUN_EQ, RUN_NE, 
+		 RUN_LT, RUN_LE, RUN_GT, RUN_GE, RUN_NEG, RUN_NOT};
+	string name;
+	
+	for (int i = 0; i < NUMBER_OF_OPERATORS; i += 1)
+	{
+		// Binary operands arrive right operand first
+		if (OPERATORS[i] == oper_ator)
+		{
+			if (i >= 13)
+				RunInstruction(OPCODES[i], FindIndex(operandStk.top()), FindIndex(operand1), 0);
+			else
+				RunInstruction(OPCODES[i], FindIndex(operandStk.top()), FindIndex(operand2), FindIndex(operand1));
+			return;
+		}
+	}
+	
+	if (oper_ator == ":=")
+	{
+		RunInstruction(RUN_MOVE, FindIndex(operand2), FindIndex(operand1), 0);
+	}
+	else if (oper_ator == "read" || oper_ator == "write")
+	{
+		operand1 += ",";
+		for (unsigned int j = 0; j < operand1.length(); j += 1)
+		{
+			if (operand1[j] == ',')
+			{
+				RunInstruction(oper_ator == "read" ? RUN_READ : RUN_WRITE, FindIndex(name), 0, 0);
+				name = "";
+			}
+			else if (operand1[j] != ' ')
+			{
+				name += operand1[j];
+			}
+		}
+	}
+	else if (oper_ator == "then" || oper_ator == "do")
+	{
+		// Jump to the label pushed by the emitter when the predicate is false
+		runPending[operandStk.top()].push_back(runCode.size());
+		RunInstruction(RUN_JUMP_IF_FALSE, 0, FindIndex(operand1), 0);
+	}
+	else if (oper_ator == "else")
+	{
+		runPending[operandStk.top()].push_back(runCode.size());
+		RunInstruction(RUN_JUMP, 0, 0, 0);
+		RunLabel(operand1);
+	}
+	else if (oper_ator == "post_if")
+	{
+		RunLabel(operand1);
+	}
+	else if (oper_ator == "while" || oper_ator == "repeat")
+	{
+		RunLabel(operandStk.top());
+	}
+	else if (oper_ator == "post_while")
+	{
+		RunInstruction(RUN_JUMP, runLabels[operand2], 0, 0);
+		RunLabel(operand1);
+	}
+	else if (oper_ator == "until")
+	{
+		RunInstruction(RUN_JUMP_IF_FALSE, runLabels[operand2], FindIndex(operand1), 0);
+	}
+	else if (oper_ator == "end" && operand1 == ".")
+	{
+		RunInstruction(RUN_HALT, 0, 0, 0);
+	}
+}
+
+// Append an instruction to the bytecode
+void RunInstruction(runOpcodes opcode, int result, int operand1, int operand2)
+{
+	runInstruction newInstruction;
+	
+	newInstruction.opcode = opcode;
+	newInstruction.result = result;
+	newInstruction.operand1 = operand1;
+	newInstruction.operand2 = operand2;
+	
+	runCode.push_back(newInstruction);
+}
+
+// Define a label at the next instruction and patch the jumps waiting for it.
+// The target of a jump is kept in its result field.
+void RunLabel(string label)
+{
+	runLabels[label] = runCode.size();
+	
+	for (unsigned int i = 0; i < runPending[label].size(); i += 1)
+		runCode[runPending[label][i]].result = runCode.size();
+	runPending.erase(label);
+}
+
+// Run the bytecode. Constants start with their values and variables with 0;
+// input and output go through the buffered standard streams.
+void RunProgram()
+{
+	vector<long long> slots(symbolTable.size(), 0);
+	const runInstruction *code = &runCode[0];
+	long long *slot = &slots[0];
+	unsigned int pc = 0;
+	bool written = false;
+	
+	for (unsigned int i = 0; i < symbolTable.size() && symbolTable[i].externalName != ""; i += 1)
+	{
+		if (symbolTable[i].mode == CONSTANT && symbolTable[i].dataType != PROG_NAME)
+			slots[i] = atoll(symbolTable[i].value.c_str());
+	}
+	
+	ios::sync_with_stdio(false);
+	
+	while (true)
+	{
+		const runInstruction &current = code[pc];
+		
+		pc += 1;
+		switch (current.opcode)
+		{
+			case RUN_ADD:
+				slot[current.result] = (long long) ((unsigned long long) slot[current.operand1] + 
+				                                    (unsigned long long) slot[current.operand2]);
+				break;
+			case RUN_SUB:
+				slot[current.result] = (long long) ((unsigned long long) slot[current.operand1] - 
+				                                    (unsigned long long) slot[current.operand2]);
+				break;
+			case RUN_MUL:
+				slot[current.result] = (long long) ((unsigned long long) slot[current.operand1] * 
+				                                    (unsigned long long) slot[current.operand2]);
+				break;
+			case RUN_DIV:
+			case RUN_MOD:
+				if (slot[current.operand2] == 0)
+				{
+					cout.flush();
+					cerr << "division by zero\n";
+					exit(2);
+				}
+				if (slot[current.operand2] == -1)
+					slot[current.result] = (current.opcode == RUN_DIV) ? 
+					                       (long long) (0 - (unsigned long long) slot[current.operand1]) : 0;
+				else if (current.opcode == RUN_DIV)
+					slot[current.result] = slot[current.operand1] / slot[current.operand2];
+				else
+					slot[current.result] = slot[current.operand1] % slot[current.operand2];
+				break;
+			// and and or compute what the RAMM code of EmitAndCode and EmitOrCode
+			// does, which differs from & and | on booleans read as other values
+			// than 0 and 1: the product, and whether the sum is not zero
+			case RUN_AND:
+				slot[current.result] = (long long) ((unsigned long long) slot[current.operand1] * 
+				                                    (unsigned long long) slot[current.operand2]);
+				break;
+			case RUN_OR:
+				slot[current.result] = ((unsigned long long) slot[current.operand1] + 
+				                        (unsigned long long) slot[current.operand2]) != 0;
+				break;
+			case RUN_EQ:
+				slot[current.result] = slot[current.operand1] == slot[current.operand2];
+				break;
+			case RUN_NE:
+				slot[current.result] = slot[current.operand1] != slot[current.operand2];
+				break;
+			case RUN_LT:
+				slot[current.result] = slot[current.operand1] < slot[current.operand2];
+				break;
+			case RUN_LE:
+				slot[current.result] = slot[current.operand1] <= slot[current.operand2];
+				break;
+			case RUN_GT:
+				slot[current.result] = slot[current.operand1] > slot[current.operand2];
+				break;
+			case RUN_GE:
+				slot[current.result] = slot[current.operand1] >= slot[current.operand2];
+				break;
+			case RUN_NEG:
+				slot[current.result] = -slot[current.operand1];
+				break;
+			case RUN_NOT:
+				slot[current.result] = !slot[current.operand1];
+				break;
+			case RUN_MOVE:
+				slot[current.result] = slot[current.operand1];
+				break;
+			case RUN_READ:
+				if (!(cin >> slot[current.result]))
+				{
+					cout.flush();
+					cerr << "input exhausted or not an integer\n";
+					exit(2);
+				}
+				break;
+			case RUN_WRITE:
+				cout << slot[current.result] << '\n';
+				if (!written)
+				{
+					written = true;
+					firstOutputSeconds = chrono::duration<double>(chrono::steady_clock::now() - programStart).count();
+				}
+				break;
+			case RUN_JUMP:
+				pc = current.result;
+				break;
+			case RUN_JUMP_IF_FALSE:
+				if (slot[current.operand1] == 0)
+					pc = current.result;
+				break;
+			case RUN_HALT:
+				cout.flush();
+				return;
+		}
+	}
+}
+
+bool CheckForJump(string opcode)
 {
-	int indexOfOperand1 = FindIndex(operand1);
-	
-	if (symbolTable[indexOfOperand1].dataType != BOOLEAN)
-	{
-		Error("predicate must be boolean valued");
-	}
-	
-	if ((operand1[0] != 'T' && CheckNonKeyID(operand1)) || operand1 == "true" || operand1 == "false")
-	{
-		objectFile << "      LDA " << setw(9) << left << symbolTable[indexOfOperand1].internalName << "\n";
-	}
-	objectFile << "      AZJ " << setw(4) << left << operand2 << "     until\n";
+	if (opcode == "AZJ" || opcode == "AMJ" || opcode == "UNJ")
+		return true;
 	
-	if (operand1[0] == 'T')
-		FreeTemp();
-		
-	currentARegister = "";
+	return false;
 }
 
 void FreeTemp()
@@ -2311,19 +4786,23 @@ void FreeTemp()
 string GetTemp()
 {
 	string temp;
+	COUNT(COUNT_TEMPS, 1);
 	currentTempNo++;
 	temp = "T" + to_string(currentTempNo);
 	if (currentTempNo > maxTempNo)
 	{
 		Insert(temp, UNKNOWN, VARIABLE, "", NO, 1);
 		maxTempNo++;
+		zeroOrOneTemps.push_back(false);
 	}
+	zeroOrOneTemps[currentTempNo] = false;
 	return temp;
 }
 
 string GetLabel()
 {
 	string temp;
+	COUNT(COUNT_LABELS, 1);
 	currentLabelNo++;
 	temp = "L" + to_string(currentLabelNo);
 	
@@ -2384,7 +4863,7 @@ string PopOperator()
 string PopOperand() 
 {
 	string returnString;
-	if (!operandStk.empty())
+	if (operandStk.size() > operandBase)
 	{
 		returnString = operandStk.top();
 		operandStk.pop();
@@ -2395,8 +4874,31 @@ string PopOperand()
 	return returnString;
 }
 
-// Token should be NON_KEY_ID
-void ConstStmts() 
+// Token should be NON_KEY_ID. The declarations are parsed in a loop. After
+// an error, parsing resumes after the next ';', or at begin or var.
+void ConstStmts()
+{
+	unsigned long long start;
+	
+	do
+	{
+		start = tokenCount;
+		
+		try
+		{
+			ConstStmt();
+		}
+		catch (compileError &)
+		{
+			Synchronize("; begin var", start);
+			if (token == ";")
+				SkipToken();
+		}
+	} while (CheckNonKeyID(token));
+}
+
+// Token should be NON_KEY_ID. Declares one constant.
+void ConstStmt() 
 {
 	string x, y;
 	int indexOfOtherOperand;
@@ -2455,13 +4957,33 @@ void ConstStmts()
 	token = NextToken();
 	if (token != "begin" && token != "var" && !CheckNonKeyID(token))
 		Error("non-keyword identifier,\"begin\", or \"var\" expected");
+}
+
+// Token should be NON_KEY_ID. The declarations are parsed in a loop. After
+// an error, parsing resumes after the next ';', or at begin.
+void VarStmts()
+{
+	unsigned long long start;
+	
+	do
+	{
+		start = tokenCount;
 		
-	if (CheckNonKeyID(token))
-		ConstStmts();
+		try
+		{
+			VarStmt();
+		}
+		catch (compileError &)
+		{
+			Synchronize("; begin", start);
+			if (token == ";")
+				SkipToken();
+		}
+	} while (CheckNonKeyID(token));
 }
 
-// Token should be NON_KEY_ID
-void VarStmts() 
+// Token should be NON_KEY_ID. Declares one list of variables.
+void VarStmt() 
 {
 	string x, y, externalName = "";
 	storeType type;
@@ -2499,27 +5021,24 @@ void VarStmts()
 	token = NextToken();
 	if (token != "begin" && !CheckNonKeyID(token))
 		Error("non-keyword identifier or \"begin\" expected");
-		
-	if (CheckNonKeyID(token))
-		VarStmts();
 }
 
-// Token should be NON_KEY_ID
+// Token should be NON_KEY_ID. Returns the comma separated list of
+// identifiers, collected in a loop.
 string Ids() 
 {
-	string temp, tempString = "";
+	string tempString = "";
 	if (!CheckNonKeyID(token))
 		Error("non-keyword identifier expected");
 		
 	tempString = token;
-	temp = token;
 	
-	if(NextToken() == ",")
+	while (NextToken() == ",")
 	{
 		token = NextToken();
 		if (!CheckNonKeyID(token))
 			Error("non-keyword identifier expected");
-		tempString = temp + "," + Ids();
+		tempString += "," + token;
 	}
 	
 	return tempString;
@@ -2531,6 +5050,7 @@ void Insert(string externalName, storeType inType, modes inMode, string inValue,
 {
 	unsigned int i = 0, currentLength = 0;
 	string currentName = "";
+	TIME_SCOPE(PHASE_LOOKUP);
 	
 	externalName += " ";
 	
@@ -2546,21 +5066,10 @@ void Insert(string externalName, storeType inType, modes inMode, string inValue,
 		if (externalName[j] == ',' || externalName[j] == ' ' || currentLength == 15)
 		{
 			// Check for multiple name definition
-			for (i = 0; i < MAX_SYMBOL_TABLE_SIZE; i += 1)
-			{
-				if (symbolTable[i].externalName == "")
-				{
-					break;
-				}
-				else
-				{
-					if (symbolTable[i].externalName == currentName)
-					{
-						Error("multiple name definition");
-					}
-				}
-			}
+			if (FindSymbol(currentName) != -1)
+				Error("multiple name definition");
 			
+			i = symbolCount;
 			if (i == MAX_SYMBOL_TABLE_SIZE)
 				Error("symbol table overflow");
 			
@@ -2599,6 +5108,16 @@ void Insert(string externalName, storeType inType, modes inMode, string inValue,
 			symbolTable[i].alloc = inAlloc;
 			symbolTable[i].units = inUnits;
 			
+			symbolIndex.insert(make_pair(symbolTable[i].externalName, i));
+			if (inType == BOOLEAN && inValue == "1" && indexOfTrue == -1)
+				indexOfTrue = i;
+			else if (inType == BOOLEAN && inValue == "0" && indexOfFalse == -1)
+				indexOfFalse = i;
+			symbolCount += 1;
+			COUNT(COUNT_SYMBOLS, 1);
+			if (symbolCount == symbolTable.size())
+				symbolTable.resize(2 * symbolTable.size());
+			
 			if (currentLength == 15)
 			{
 				while (externalName[j] != ',' && externalName[j] != ' ')
@@ -2642,18 +5161,10 @@ storeType WhichType(string name)
 	// Name is an identifier and hopefully a constant
 	else 
 	{
-		unsigned int i = 0;
+		int i = FindSymbol(name);
 		
-		for (i = 0; i < symbolTable.size(); i += 1)
-		{
-			if (symbolTable[i].externalName == "")
-				break;
-			else if (symbolTable[i].externalName == name && symbolTable[i].mode == CONSTANT)
-			{
-				constantAlreadyExists = true;
-				break;
-			}
-		}
+		if (i != -1 && symbolTable[i].mode == CONSTANT)
+			constantAlreadyExists = true;
 		
 		if (constantAlreadyExists)
 			data_type = symbolTable[i].dataType;
@@ -2685,20 +5196,10 @@ string WhichValue(string name)
 	// Name is an identifier and hopefully a constant
 	else 
 	{
-		unsigned int i = 0;
+		int i = FindSymbol(name);
 		
-		for (i = 0; i < symbolTable.size(); i += 1)
-		{
-			if (symbolTable[i].externalName == "")
-			{
-				break;
-			}
-			else if (symbolTable[i].externalName == name && symbolTable[i].mode == CONSTANT)
-			{
-				constantAlreadyExists = true;
-				break;
-			}
-		}
+		if (i != -1 && symbolTable[i].mode == CONSTANT)
+			constantAlreadyExists = true;
 		
 		//if (constantAlreadyExists && symbolTable[i].value != "")
 		if (constantAlreadyExists)
@@ -2713,78 +5214,64 @@ string WhichValue(string name)
 // Tells which mode a name is in.
 modes WhichMode(string name)
 {
-	modes returnModes;
+	int i = FindSymbol(name);
 	
-	for (unsigned int i = 0; i < symbolTable.size(); i += 1)
-	{
-		if (symbolTable[i].externalName == "")
-		{
-			Error("reference to undefined constant");
-		}
-		else if (symbolTable[i].externalName == name)
-		{
-			returnModes = symbolTable[i].mode;
-			break;
-		}
-	}
+	if (i == -1)
+		Error("reference to undefined constant");
 	
-	return returnModes;
+	return symbolTable[i].mode;
 }
 
 // Returns the index of a symbol from the external name
 int FindIndex(string name)
 {
-	int returnIndex;
+	int i = FindSymbol(name);
 	
-	for (unsigned int i = 0; i < symbolTable.size(); i += 1)
-	{
-		if (symbolTable[i].externalName == "")
-		{
-			Error("reference to undefined constant");
-		}
-		else if (symbolTable[i].externalName == name)
-		{
-			returnIndex = i;
-			break;
-		}
-	}
+	if (i == -1)
+		Error("reference to undefined constant");
+	
+	return i;
+}
+
+// Returns the index of the first symbol with the external name, or -1
+int FindSymbol(string name)
+{
+	TIME_SCOPE(PHASE_LOOKUP);
+	COUNT(COUNT_LOOKUPS, 1);
+	COUNT(COUNT_PROBES, symbolIndex.bucket_size(symbolIndex.bucket(name)));
+	
+	unordered_map<string, int>::iterator it = symbolIndex.find(name);
 	
-	return returnIndex;
+	if (it == symbolIndex.end())
+		return -1;
+	
+	return it->second;
 }
 
 // Finds the index of a boolean that has a value of true.
 // Returns -1 if no such boolean exists.
 int FindIndexOfTrue()
 {
-	for (unsigned int i = 0; i < symbolTable.size(); i += 1)
-	{
-		if (symbolTable[i].dataType == BOOLEAN && symbolTable[i].value == "1")
-		{
-			return i;
-		}
-	}
-	
-	return -1;
+	return indexOfTrue;
 }
 
 // Finds the index of a boolean that has a value of false.
 // Returns -1 if no such boolean exists.
 int FindIndexOfFalse()
 {
-	for (unsigned int i = 0; i < symbolTable.size(); i += 1)
-	{
-		if (symbolTable[i].dataType == BOOLEAN && symbolTable[i].value == "0")
-		{
-			return i;
-		}
-	}
-	
-	return -1;
+	return indexOfFalse;
 }
 
 // Returns the next token or end of file marker.
 string NextToken()
 {
+	if (pipelined && !lexingThread)
+		return ReceiveToken();
+	
+	TIME_SCOPE(PHASE_LEX);
+	COUNT(COUNT_TOKENS, 1);
+	tokenCount += 1;
+	
 	token = "";
 	while (token == "")
 	{
@@ -2903,50 +5390,372 @@ char NextChar()
 	{
 		charac = END_OF_FILE;
 	}
+	else
+	{
+		sourcePosition += 1;
+	}
 	
-	// Print to listing file (starting new line if necessary)
-	if (lineNumber == 0 && charac == END_OF_FILE)
+	EchoCharacter(charac);
+	
+	return charac;
+}
+
+// Count the lines of a character read from the source and print it to the
+// listing file (starting new line if necessary), unless this thread does not
+// echo the source: with --check and on the lexer thread of --pipeline
+void EchoCharacter(char c)
+{
+	if (lineNumber == 0 && c == END_OF_FILE)
 	{
 		lineNumber += 1;
-		listingFile << right << setw(5) << lineNumber << "|";
-		return charac;
+		if (echoSource)
+			listingFile << right << setw(5) << lineNumber << "|";
+		return;
 	}
 	
 	if (lineNumber == 0)
 	{
 		lineNumber += 1;
-		listingFile << right << setw(5) << lineNumber << "|";
+		if (echoSource)
+			listingFile << right << setw(5) << lineNumber << "|";
 	}
 	
-	if (charac != END_OF_FILE)
+	if (c != END_OF_FILE)
 	{
 		if (printLineNumber)
 		{
 			lineNumber += 1;
-			listingFile << right << setw(5) << lineNumber << "|";
+			if (echoSource)
+				listingFile << right << setw(5) << lineNumber << "|";
 			printLineNumber = false;
 		}
 		
-		if (charac == '\n')
+		if (c == '\n')
 		{
 			printLineNumber = true;
 		}
 		
-		listingFile << charac;
+		if (echoSource)
+			listingFile << c;
 	}
-	
-	return charac;
 }
 
-// Print error message to listing
+// Print error message to listing. Below the error limit the parser
+// recovers; at the limit compilation terminates.
 void Error(string errorMessage)
 {
-	listingFile << "\nError: Line " << lineNumber << ": " << errorMessage;
-	listingFile << "\n\nCOMPILATION TERMINATED      1 ERRORS ENCOUNTERED\n";
+	// The lexer thread of --pipeline hands its errors to the parser, which
+	// reports them when it reaches the token
+	if (lexingThread)
+	{
+		lexerError = errorMessage;
+		throw compileError();
+	}
+	
+	// Errors of the tokens skipped while recovering are not reported
+	if (recovering)
+		throw compileError();
+	
+	errorCount += 1;
+	if (writerThread.joinable())
+		PostListing("\nError: Line " + to_string(lineNumber) + ": " + errorMessage + "\n", false);
+	else
+		listingFile << "\nError: Line " << lineNumber << ": " << errorMessage << "\n";
+	
+	// --run and --check write no listing
+	if (runProgram || checkOnly)
+		cerr << "Error: Line " << lineNumber << ": " << errorMessage << "\n";
+	
+	if (errorCount != maxErrors)
+		throw compileError();
+	
+	StopPipeline();
+	CreateListingTrailer();
+	
+	// Keep the object code generated before the error
+	if (target == "ramm" && !checkOnly)
+		WriteObjectCode();
 	
 	exit(1);
 }
 
+// Skip tokens until one of the space separated stop tokens or the end of
+// the file. A construct that failed before consuming a token loses its first
+// token, so the parser always makes progress. At the end of the file there
+// is nothing to resume, and the error is passed on.
+void Synchronize(string stopTokens, unsigned long long start)
+{
+	stopTokens = " " + stopTokens + " ";
+	
+	if (tokenCount == start && token[0] != END_OF_FILE)
+		SkipToken();
+	
+	while (stopTokens.find(" " + token + " ") == string::npos && token[0] != END_OF_FILE)
+		SkipToken();
+	
+	if (token[0] == END_OF_FILE)
+		throw compileError();
+}
+
+// Read the next token, passing over characters that cannot begin one
+void SkipToken()
+{
+	recovering = true;
+	try
+	{
+		NextToken();
+	}
+	catch (compileError &)
+	{
+		if (token == "")
+			SkipCharacter();
+	}
+	recovering = false;
+}
+
+// Start the lexer thread of --pipeline, and the listing writer when there
+// is a listing
+void StartPipeline(string sourceName)
+{
+	tokenRing.records.resize(TOKEN_RING_SIZE);
+	listingRing.records.resize(LISTING_RING_SIZE);
+	echoSource = false;
+	
+	lexerThread = thread(LexerThread);
+	if (!runProgram && !checkOnly)
+		writerThread = thread(WriterThread, sourceName);
+}
+
+// Let the listing writer echo the source up to the parser and finish, and
+// stop the lexer wherever it is. Afterwards the parser's thread writes the
+// listing itself.
+void StopPipeline()
+{
+	if (!pipelined)
+		return;
+	
+	if (writerThread.joinable())
+	{
+		PostListing("", true);
+		writerThread.join();
+	}
+	
+	pipelineStopping = true;
+	WakeWaiters(tokenRing.signal);
+	WakeWaiters(commandSignal);
+	lexerThread.join();
+	pipelined = false;
+}
+
+// Lex the source into the token ring until the end of the file
+void LexerThread()
+{
+	pipelineRecord next;
+	int command;
+	bool stuck;
+	
+	lexingThread = true;
+	echoSource = false;
+	NextChar();
+	
+	while (true)
+	{
+		next.error = "";
+		try
+		{
+			NextToken();
+		}
+		catch (compileError &)
+		{
+			next.error = lexerError;
+		}
+		next.text = token;
+		next.line = lineNumber;
+		next.position = sourcePosition;
+		stuck = next.error != "" && token == "";
+		
+		if (!PushRecord(tokenRing, next))
+			return;
+		
+		// An error that left no token is lexed again or passed over, as the
+		// parser's recovery decides; the end of the file is never passed
+		if (stuck)
+		{
+			do
+			{
+				while ((command = lexerCommand.exchange(LEXER_WAIT)) == LEXER_WAIT)
+				{
+					if (pipelineStopping)
+						return;
+					WaitForChange(commandSignal, lexerCommand, (int) LEXER_WAIT);
+				}
+				WakeWaiters(commandSignal);
+				
+				if (command == LEXER_SKIP)
+					NextChar();
+			} while (command == LEXER_SKIP);
+		}
+		else if (token[0] == END_OF_FILE)
+		{
+			return;
+		}
+	}
+}
+
+// Echo the source to the listing up to each position the parser sends, and
+// write the text that comes with it, until the last one
+void WriterThread(string sourceName)
+{
+	ifstream source(sourceName.c_str());
+	pipelineRecord request;
+	unsigned long long echoed = 0;
+	char c;
+	
+	if (source.peek() == EOF)
+		EchoCharacter(END_OF_FILE);
+	
+	do
+	{
+		PopRecord(listingRing, request);
+		while (echoed < request.position && source.get(c))
+		{
+			echoed += 1;
+			EchoCharacter(c);
+		}
+		listingFile << request.text;
+	} while (!request.last);
+}
+
+// Returns the next token of the lexer thread, with the line and source
+// position it was read at, reporting its error if it has one. At the end of
+// the file the lexer stops, and the last token is returned again.
+string ReceiveToken()
+{
+	tokenCount += 1;
+	
+	if (lexerWaiting)
+	{
+		SendLexerCommand(LEXER_NEXT);
+		lexerWaiting = false;
+	}
+	
+	if (lastToken.text == "" || lastToken.text[0] != END_OF_FILE || lastToken.error != "")
+		PopRecord(tokenRing, lastToken);
+	
+	token = lastToken.text;
+	lineNumber = lastToken.line;
+	listingPosition = lastToken.position;
+	
+	if (writerThread.joinable() && tokenCount % LISTING_INTERVAL == 0)
+		PostListing("", false);
+	
+	if (lastToken.error != "")
+	{
+		lexerWaiting = token == "";
+		Error(lastToken.error);
+	}
+	
+	return token;
+}
+
+// Send the listing writer the parser's position in the source and the text
+// to write there
+void PostListing(string text, bool last)
+{
+	pipelineRecord request;
+	
+	request.text = text;
+	request.position = listingPosition;
+	request.last = last;
+	PushRecord(listingRing, request);
+}
+
+// Pass over the character the lexer stopped at. The lexer thread of
+// --pipeline waits for this after an error that left no token.
+void SkipCharacter()
+{
+	if (pipelined)
+		SendLexerCommand(LEXER_SKIP);
+	else
+	{
+		NextChar();
+	}
+}
+
+// Append a record to a ring, waiting while it is full. Returns false if the
+// pipeline stops first.
+bool PushRecord(pipelineRing &ring, pipelineRecord &record)
+{
+	unsigned long long tail = ring.tail.load(memory_order_relaxed), head;
+	
+	while (tail - (head = ring.head.load(memory_order_acquire)) == ring.records.size())
+	{
+		if (pipelineStopping)
+			return false;
+		WaitForChange(ring.signal, ring.head, head);
+	}
+	
+	ring.records[tail % ring.records.size()] = move(record);
+	ring.tail.store(tail + 1, memory_order_release);
+	WakeWaiters(ring.signal);
+	return true;
+}
+
+// Take the first record of a ring, waiting while it is empty
+void PopRecord(pipelineRing &ring, pipelineRecord &record)
+{
+	unsigned long long head = ring.head.load(memory_order_relaxed);
+	
+	while (ring.tail.load(memory_order_acquire) == head)
+		WaitForChange(ring.signal, ring.tail, head);
+	
+	record = move(ring.records[head % ring.records.size()]);
+	ring.head.store(head + 1, memory_order_release);
+	WakeWaiters(ring.signal);
+}
+
+// Wait until value is no longer seen or the pipeline stops: yield a few
+// times, then sleep on the signal. The sleeper registers and checks value
+// under the lock, and WakeWaiters checks for sleepers after the change, so
+// one of them always sees the other.
+template <typename T> void WaitForChange(pipelineSignal &signal, atomic<T> &value, T seen)
+{
+	for (unsigned int i = 0; i < PIPELINE_SPINS; i += 1)
+	{
+		if (value.load(memory_order_acquire) != seen || pipelineStopping)
+			return;
+		this_thread::yield();
+	}
+	
+	unique_lock<mutex> guard(signal.lock);
+	signal.sleepers += 1;
+	while (value.load() == seen && !pipelineStopping)
+		signal.changed.wait(guard);
+	signal.sleepers -= 1;
+}
+
+// Wake the threads asleep on a signal after what they wait for has changed
+void WakeWaiters(pipelineSignal &signal)
+{
+	atomic_thread_fence(memory_order_seq_cst);
+	if (signal.sleepers.load() != 0)
+	{
+		lock_guard<mutex> guard(signal.lock);
+		signal.changed.notify_all();
+	}
+}
+
+// Give the lexer thread a command once it has taken the last one
+void SendLexerCommand(int command)
+{
+	int pending;
+	
+	while ((pending = lexerCommand.load()) != LEXER_WAIT)
+		WaitForChange(commandSignal, lexerCommand, pending);
+	lexerCommand = command;
+	WakeWaiters(commandSignal);
+}
+
 // Check to make sure the token starts with a lowercase letter and
 // is only composed of lowercase letters, numbers, and underscores.
 bool CheckNonKeyID(string currentToken)
@@ -3057,19 +5866,20 @@ bool IsTokenABool(string name)
 
 bool IsNameInSymbolTable(string name)
 {
-	unsigned int i = 0;
-		
-	for (i = 0; i < symbolTable.size(); i += 1)
+	return FindSymbol(name) != -1;
+}
+
+bool CheckForLabelName(string name)
+{
+	if (name.length() < 2 || name[0] != 'L')
+		return false;
+	for (unsigned int i = 1; i < name.length(); i += 1)
 	{
-		if (symbolTable[i].externalName == "")
+		if (!isdigit(name[i]))
 			return false;
-		else if (symbolTable[i].externalName == name)
-		{
-			return true;
-		}
 	}
 	
-	return false;
+	return true;
 }
 
 bool CheckForTempName(string name)
@@ -3085,6 +5895,15 @@ bool CheckForTempName(string name)
 	return true;
 }
 
+// Is name a constant, or a temporary known to hold 0 or 1
+bool IsZeroOrOne(string name)
+{
+	if (CheckForTempName(name))
+		return zeroOrOneTemps[stoi(name.substr(1))];
+	
+	return WhichMode(name) == CONSTANT;
+}
+
 // Generate an internal name based on data type and current count of that data type
 string GenInternalName(storeType type)
 {